@@ -0,0 +1,65 @@
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "CellPool.h"
+#include "Upvalue.h"
+#include "Value.h"
+
+
+namespace lox {
+
+// gives the slot a fresh binding holding value; a cell only the slot refers
+// to is indistinguishable from a new one, so it is reused as is
+
+void CellPool::define(std::shared_ptr<Upvalue>& cell, const Value& value) {
+  if (cell != nullptr && cell.use_count() == 1) {
+    hits++;
+    cell->set(value);
+    return;
+  }
+
+  if (!free.empty()) {
+    hits++;
+    cell = std::move(free.back());
+    free.pop_back();
+    cell->set(value);
+    return;
+  }
+
+  misses++;
+  cell = std::make_shared<Upvalue>(value);
+}
+
+
+// drops the cells from base on, keeping the ones no closure captured
+
+void CellPool::release(
+    std::vector<std::shared_ptr<Upvalue>>& cells,
+    const std::size_t& base) {
+  for (std::size_t i = base; i < cells.size(); i++) {
+    if (free.size() == MAX_FREE) {
+      break;
+    }
+    if (cells[i] != nullptr && cells[i].use_count() == 1) {
+      // the old value must not stay reachable through the pool
+      cells[i]->set(nullptr);
+      free.push_back(std::move(cells[i]));
+    }
+  }
+
+  cells.resize(base);
+}
+
+
+void CellPool::report(std::ostream& out) const {
+  std::uint64_t total = hits + misses;
+  out << "[pool] cells: " << total << " defined, " << hits << " recycled ("
+      << (total == 0 ? 0.0 : 100.0 * hits / total) << "%), " << free.size()
+      << " free\n";
+  out.flush();
+}
+
+}  // namespace lox
@@ -0,0 +1,42 @@
+#ifndef CELLPOOL_H
+#define CELLPOOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <vector>
+
+#include "Upvalue.h"
+#include "Value.h"
+
+
+namespace lox {
+
+// Recycles the cells that box captured locals. A frame's cells go back to
+// the pool when it returns, unless a closure still shares them, and a
+// declaration that runs again reuses its old cell in place when nothing
+// captured it. Recursive code that declares captured locals then stops
+// allocating once the pool has warmed up.
+
+class CellPool {
+ private:
+  // a burst of deep recursion should not pin its cells forever
+  static constexpr std::size_t MAX_FREE = 4096;
+
+  std::vector<std::shared_ptr<Upvalue>> free;
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+
+ public:
+  void define(std::shared_ptr<Upvalue>& cell, const Value& value);
+  void release(
+      std::vector<std::shared_ptr<Upvalue>>& cells,
+      const std::size_t& base);
+  void report(std::ostream& out) const;
+};
+
+
+}  // namespace lox
+
+#endif
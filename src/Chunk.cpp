@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "Chunk.h"
+#include "Token.h"
+#include "Value.h"
+
+
+namespace lox {
+
+void Chunk::write(const std::uint8_t& byte, const int& line) {
+  if (lines.empty() || lines.back().line != line) {
+    lines.push_back(LineRun{static_cast<int>(code.size()), line});
+  }
+
+  code.push_back(byte);
+}
+
+
+void Chunk::write(const OpCode& op, const int& line) {
+  Chunk::write(static_cast<std::uint8_t>(op), line);
+}
+
+
+void Chunk::writeShort(const std::uint16_t& operand, const int& line) {
+  Chunk::write(static_cast<std::uint8_t>(operand >> 8), line);
+  Chunk::write(static_cast<std::uint8_t>(operand & 0xff), line);
+}
+
+
+void Chunk::patchShort(
+    const std::size_t& offset,
+    const std::uint16_t& operand) {
+  code[offset] = static_cast<std::uint8_t>(operand >> 8);
+  code[offset + 1] = static_cast<std::uint8_t>(operand & 0xff);
+}
+
+
+// identical constants share a pool entry
+
+int Chunk::addConstant(const Value& value) {
+  for (std::size_t i = 0; i < constants.size(); i++) {
+    if (constants[i].getBits() == value.getBits()) {
+      return i;
+    }
+  }
+
+  constants.push_back(value);
+  return constants.size() - 1;
+}
+
+
+int Chunk::addName(const Token& name) {
+  names.push_back(name);
+  return names.size() - 1;
+}
+
+
+const std::vector<std::uint8_t>& Chunk::getCode() const {
+  return code;
+}
+
+
+const std::vector<Value>& Chunk::getConstants() const {
+  return constants;
+}
+
+
+const Token& Chunk::getName(const int& index) const {
+  return names[index];
+}
+
+
+// the line of the run the offset falls in
+
+int Chunk::getLine(const std::size_t& offset) const {
+  auto run = std::upper_bound(
+      lines.begin(),
+      lines.end(),
+      offset,
+      [](const std::size_t& offset, const LineRun& run) {
+        return offset < static_cast<std::size_t>(run.offset);
+      });
+
+  if (run == lines.begin()) {
+    return 0;
+  }
+
+  return std::prev(run)->line;
+}
+
+
+std::size_t Chunk::size() const {
+  return code.size();
+}
+
+}  // namespace lox
@@ -0,0 +1,120 @@
+#ifndef CHUNK_H
+#define CHUNK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Token.h"
+#include "Value.h"
+
+
+namespace lox {
+
+// Every instruction, in the order the VM's dispatch table lists them.
+// Operands follow the opcode; two-byte operands are big-endian.
+//
+//   CONSTANT index            push constants[index]
+//   GET_LOCAL slot            push the frame's stack slot
+//   DEFINE_LOCAL slot         pop into the frame's stack slot
+//   SET_LOCAL slot            store the top into the slot, keep it
+//   GET/DEFINE/SET_CELL i     same for the frame's captured cells; DEFINE
+//                             boxes the value in a fresh cell
+//   GET/SET_UPVALUE i         same for the running closure's captures
+//   GET/DEFINE/SET_GLOBAL slot name
+//   GET/SET_PROPERTY name
+//   GET_SUPER name            [this][superclass] -> bound method
+//   JUMP/JUMP_IF_FALSE/LOOP offset
+//   CALL argc
+//   TAIL_CALL argc            CALL that reuses the returning frame
+//   CLOSURE function
+//   CLASS name methods hasSuperclass(byte)
+
+#define LOX_OPCODES(X) \
+  X(CONSTANT)          \
+  X(NIL)               \
+  X(TRUE)              \
+  X(FALSE)             \
+  X(POP)               \
+  X(GET_LOCAL)         \
+  X(DEFINE_LOCAL)      \
+  X(SET_LOCAL)         \
+  X(GET_CELL)          \
+  X(DEFINE_CELL)       \
+  X(SET_CELL)          \
+  X(GET_UPVALUE)       \
+  X(SET_UPVALUE)       \
+  X(GET_GLOBAL)        \
+  X(DEFINE_GLOBAL)     \
+  X(SET_GLOBAL)        \
+  X(GET_PROPERTY)      \
+  X(SET_PROPERTY)      \
+  X(GET_SUPER)         \
+  X(EQUAL)             \
+  X(GREATER)           \
+  X(GREATER_EQUAL)     \
+  X(LESS)              \
+  X(LESS_EQUAL)        \
+  X(ADD)               \
+  X(SUBTRACT)          \
+  X(MULTIPLY)          \
+  X(DIVIDE)            \
+  X(NOT)               \
+  X(NEGATE)            \
+  X(PRINT)             \
+  X(JUMP)              \
+  X(JUMP_IF_FALSE)     \
+  X(LOOP)              \
+  X(CALL)              \
+  X(TAIL_CALL)         \
+  X(CLOSURE)           \
+  X(CLASS)             \
+  X(RETURN)
+
+
+#define LOX_OPCODE_ENUM(name) OP_##name,
+
+enum OpCode : std::uint8_t { LOX_OPCODES(LOX_OPCODE_ENUM) };
+
+#undef LOX_OPCODE_ENUM
+
+
+// a run of bytecode that came from the same source line
+
+struct LineRun {
+  int offset;
+  int line;
+};
+
+
+// Bytecode for one function, with the constants and names its operands
+// refer to. Lines are kept run-length encoded and only consulted when an
+// error is reported.
+
+class Chunk {
+ private:
+  std::vector<std::uint8_t> code;
+  std::vector<Value> constants;
+  std::vector<Token> names;
+  std::vector<LineRun> lines;
+
+ public:
+  void write(const std::uint8_t& byte, const int& line);
+  void write(const OpCode& op, const int& line);
+  void writeShort(const std::uint16_t& operand, const int& line);
+  void patchShort(const std::size_t& offset, const std::uint16_t& operand);
+
+  int addConstant(const Value& value);
+  int addName(const Token& name);
+
+  const std::vector<std::uint8_t>& getCode() const;
+  const std::vector<Value>& getConstants() const;
+  const Token& getName(const int& index) const;
+  int getLine(const std::size_t& offset) const;
+  std::size_t size() const;
+};
+
+
+}  // namespace lox
+
+#endif
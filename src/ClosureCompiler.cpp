@@ -0,0 +1,1047 @@
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "ClosureCompiler.h"
+#include "Expr.h"
+#include "Heap.h"
+#include "Interpreter.h"
+#include "LoxCallable.h"
+#include "LoxClass.h"
+#include "LoxFunction.h"
+#include "LoxInstance.h"
+#include "LoxString.h"
+#include "RuntimeError.h"
+#include "Stmt.h"
+#include "Token.h"
+#include "TokenType.h"
+#include "TypeFeedback.h"
+#include "Upvalue.h"
+#include "Value.h"
+
+
+namespace lox {
+
+ClosureCompiler::ClosureCompiler(lox::Interpreter& interpreter)
+    : interpreter(interpreter) {}
+
+
+CompiledStmt ClosureCompiler::compile(
+    const std::vector<lox::stmt::Stmt>& statements) {
+  return ClosureCompiler::compileBlock(statements);
+}
+
+
+CompiledStmt ClosureCompiler::compile(const lox::stmt::Stmt& _stmt) {
+  return _stmt.accept(*this);
+}
+
+
+CompiledExpr ClosureCompiler::compile(const lox::expr::Expr& _expr) {
+  return _expr.accept(*this);
+}
+
+
+// conditions
+//
+// Comparisons, logical operators, ! and literals record a form that yields
+// a native bool next to their value form. A branch or loop tests through
+// it, so its condition is never boxed into a Value and tested again; any
+// other expression is tested for truth as it is.
+
+CompiledCondition ClosureCompiler::compileCondition(
+    const lox::expr::Expr& _expr) {
+  return ClosureCompiler::test(_expr, ClosureCompiler::compile(_expr));
+}
+
+
+CompiledCondition ClosureCompiler::test(
+    const lox::expr::Expr& _expr,
+    const CompiledExpr& value) const {
+  const CompiledCondition& condition = conditions[_expr.getId()];
+  if (condition) {
+    return condition;
+  }
+
+  return [in = &interpreter, value]() { return in->isTruthy(value()); };
+}
+
+
+CompiledExpr ClosureCompiler::compileBool(
+    const lox::expr::Expr& _expr,
+    const CompiledCondition& condition) {
+  conditions.set(_expr.getId(), condition);
+  return [condition]() -> Value { return condition(); };
+}
+
+
+// a statement list runs as one flat loop: nested blocks are spliced into it
+// rather than compiled to a step of their own
+
+CompiledStmt ClosureCompiler::compileBlock(
+    const std::vector<lox::stmt::Stmt>& statements) {
+  std::vector<CompiledStmt> body;
+  ClosureCompiler::compileInline(statements, body);
+
+  if (body.empty()) {
+    return []() { return Completion::NORMAL; };
+  }
+
+  if (body.size() == 1) {
+    return body.front();
+  }
+
+  return [body = std::move(body)]() {
+    for (const CompiledStmt& statement : body) {
+      Completion completion = statement();
+      if (completion != Completion::NORMAL) {
+        return completion;
+      }
+    }
+    return Completion::NORMAL;
+  };
+}
+
+
+void ClosureCompiler::compileInline(
+    const std::vector<lox::stmt::Stmt>& statements,
+    std::vector<CompiledStmt>& body) {
+  for (const lox::stmt::Stmt& statement : statements) {
+    const lox::stmt::Block* block = interpreter.getBlock(statement.getId());
+
+    if (block != nullptr) {
+      ClosureCompiler::compileInline(block->getStatements(), body);
+    } else {
+      body.push_back(ClosureCompiler::compile(statement));
+    }
+  }
+}
+
+
+void ClosureCompiler::compileBody(const lox::stmt::Function& function) {
+  interpreter.bodies.set(
+      function.getId(), ClosureCompiler::compileBlock(function.getBody()));
+}
+
+
+// block stmt
+
+CompiledStmt ClosureCompiler::visitBlockStmt(const lox::stmt::Block& _stmt) {
+  return ClosureCompiler::compileBlock(_stmt.getStatements());
+}
+
+
+// class stmt
+
+CompiledStmt ClosureCompiler::visitClassStmt(const lox::stmt::Class& _stmt) {
+  Interpreter* in = &interpreter;
+  CompiledExpr superclass = nullptr;
+  Setter defineSuper = nullptr;
+  Token superName = _stmt.getName();
+
+  if (_stmt.getSuperclass() != nullptr) {
+    superclass = ClosureCompiler::compile(_stmt.getSuperclass());
+    defineSuper = ClosureCompiler::compileDefine(_stmt.getSuperId());
+    superName = _stmt.getSuperclass().getName();
+  }
+
+  std::vector<const FunctionPrototype*> methods;
+  for (const lox::stmt::Function& method : _stmt.getMethods()) {
+    ClosureCompiler::compileBody(method);
+    methods.push_back(interpreter.getPrototype(method.getId()));
+  }
+
+  return [in,
+          superclass,
+          defineSuper,
+          superName,
+          methods,
+          name = _stmt.getName().getLexeme(),
+          define = ClosureCompiler::compileDefine(_stmt.getId()),
+          store = ClosureCompiler::compileStore(_stmt.getId())]() {
+    Value parent = nullptr;
+
+    if (superclass) {
+      parent = superclass();
+      if (!parent.is(ObjectType::OBJ_CLASS)) {
+        throw RuntimeError(superName, "Superclass must be a class.");
+      }
+    }
+
+    define(nullptr);
+
+    if (superclass) {
+      defineSuper(parent);
+    }
+
+    TemporaryRoots roots(in->heap);
+    std::unordered_map<std::string, LoxFunction*> table;
+
+    for (const FunctionPrototype* method : methods) {
+      LoxFunction* function = in->heap.allocate<LoxFunction>(
+          method, in->capture(method->declaration->getId()));
+      roots.push(function);
+      table[method->name] = function;
+    }
+
+    store(in->heap.allocate<LoxClass>(
+        name, parent.isNil() ? nullptr : parent.as<LoxClass>(), table));
+    return Completion::NORMAL;
+  };
+}
+
+
+// expression stmt
+
+CompiledStmt ClosureCompiler::visitExpressionStmt(
+    const lox::stmt::Expression& _stmt) {
+  return [expression = ClosureCompiler::compile(_stmt.getExpression())]() {
+    expression();
+    return Completion::NORMAL;
+  };
+}
+
+
+// function stmt
+
+CompiledStmt ClosureCompiler::visitFunctionStmt(
+    const lox::stmt::Function& _stmt) {
+  ClosureCompiler::compileBody(_stmt);
+
+  return [in = &interpreter,
+          prototype = interpreter.getPrototype(_stmt.getId()),
+          define = ClosureCompiler::compileDefine(_stmt.getId()),
+          store = ClosureCompiler::compileStore(_stmt.getId())]() {
+    // the name is in scope first, so a recursive function can capture itself
+    define(nullptr);
+    store(in->heap.allocate<LoxFunction>(
+        prototype, in->capture(prototype->declaration->getId())));
+    return Completion::NORMAL;
+  };
+}
+
+
+// if stmt
+
+CompiledStmt ClosureCompiler::visitIfStmt(const lox::stmt::If& _stmt) {
+  Interpreter* in = &interpreter;
+  CompiledStmt thenBranch = ClosureCompiler::compile(_stmt.getThenBranch());
+  const Fusion& fusion = interpreter.getFusion(_stmt.getId());
+
+  if (fusion.pattern == Pattern::COMPARE_BRANCH) {
+    CompiledStmt elseBranch = _stmt.getElseBranch() == nullptr
+        ? nullptr
+        : ClosureCompiler::compile(_stmt.getElseBranch());
+
+    return [in, fusion, thenBranch, elseBranch]() {
+      in->fusionRuns[static_cast<int>(Pattern::COMPARE_BRANCH)]++;
+      if (ClosureCompiler::compare(in, fusion)) {
+        return thenBranch();
+      }
+      return elseBranch ? elseBranch() : Completion::NORMAL;
+    };
+  }
+
+  CompiledCondition condition =
+      ClosureCompiler::compileCondition(_stmt.getCondition());
+
+  if (_stmt.getElseBranch() == nullptr) {
+    return [condition, thenBranch]() {
+      if (condition()) {
+        return thenBranch();
+      }
+      return Completion::NORMAL;
+    };
+  }
+
+  CompiledStmt elseBranch = ClosureCompiler::compile(_stmt.getElseBranch());
+
+  return [condition, thenBranch, elseBranch]() {
+    if (condition()) {
+      return thenBranch();
+    }
+    return elseBranch();
+  };
+}
+
+
+// print stmt
+
+CompiledStmt ClosureCompiler::visitPrintStmt(const lox::stmt::Print& _stmt) {
+  return [in = &interpreter,
+          expression = ClosureCompiler::compile(_stmt.getExpression())]() {
+    in->print(expression());
+    return Completion::NORMAL;
+  };
+}
+
+
+// return stmt
+
+CompiledStmt ClosureCompiler::visitReturnStmt(const lox::stmt::Return& _stmt) {
+  Interpreter* in = &interpreter;
+
+  if (_stmt.getValue() == nullptr) {
+    return [in]() {
+      in->returnValue = nullptr;
+      return Completion::RETURN;
+    };
+  }
+
+  // the call is left for the returning function's caller to make; see
+  // LoxFunction::invoke
+  if (const lox::expr::Call* call = interpreter.getTailCall(_stmt.getId())) {
+    std::vector<CompiledExpr> arguments;
+    for (const lox::expr::Expr& argument : call->getArguments()) {
+      arguments.push_back(ClosureCompiler::compile(argument));
+    }
+
+    return [in,
+            callee = ClosureCompiler::compileCallee(*call),
+            arguments = std::move(arguments),
+            paren = call->getParen()]() {
+      TemporaryRoots roots(in->heap);
+      Value receiver = nullptr;
+      Value function = callee(receiver, roots);
+
+      Arguments values;
+      for (const CompiledExpr& argument : arguments) {
+        values.push(argument());
+        roots.push(values.back());
+      }
+
+      return in->scheduleTailCall(function, receiver, paren, values.values());
+    };
+  }
+
+  return [in, value = ClosureCompiler::compile(_stmt.getValue())]() {
+    in->returnValue = value();
+    return Completion::RETURN;
+  };
+}
+
+
+// var stmt
+
+CompiledStmt ClosureCompiler::visitVarStmt(const lox::stmt::Var& _stmt) {
+  const Fusion& fusion = interpreter.getFusion(_stmt.getId());
+
+  if (fusion.pattern == Pattern::COPY_LOCAL) {
+    return [in = &interpreter,
+            from = fusion.left.slot,
+            to = fusion.right.slot]() {
+      in->fusionRuns[static_cast<int>(Pattern::COPY_LOCAL)]++;
+      Value* frame = &in->stack[in->frame.stackBase];
+      frame[to] = frame[from];
+      return Completion::NORMAL;
+    };
+  }
+
+  Setter define = ClosureCompiler::compileDefine(_stmt.getId());
+
+  if (_stmt.getInitializer() == nullptr) {
+    return [define]() {
+      define(nullptr);
+      return Completion::NORMAL;
+    };
+  }
+
+  return [define,
+          initializer = ClosureCompiler::compile(_stmt.getInitializer())]() {
+    define(initializer());
+    return Completion::NORMAL;
+  };
+}
+
+
+// while stmt
+//
+// A counted loop keeps its counter and bound as doubles while both are
+// numbers. After each pass of the body the counter's slot must still hold
+// the counter and a local bound must be unchanged; if the body assigned
+// either, the loop deoptimizes for good and carries on as a plain while
+// from where it stands. The flag only picks the path of later runs: a
+// recursive run may set it while this one is still counting natively.
+
+CompiledStmt ClosureCompiler::visitWhileStmt(const lox::stmt::While& _stmt) {
+  const Fusion& fusion = interpreter.getFusion(_stmt.getId());
+
+  if (fusion.pattern == Pattern::COUNTED_LOOP) {
+    return [in = &interpreter,
+            fusion,
+            condition = ClosureCompiler::compileCondition(_stmt.getCondition()),
+            body = ClosureCompiler::compile(*fusion.body),
+            increment = ClosureCompiler::compile(*fusion.increment),
+            deoptimized = false]() mutable {
+      Value start = ClosureCompiler::operand(in, fusion.left);
+      Value limit = ClosureCompiler::operand(in, fusion.right);
+
+      if (!deoptimized && start.isNumber() && limit.isNumber()) {
+        in->fusionRuns[static_cast<int>(Pattern::COUNTED_LOOP)]++;
+        const Token& op = fusion.operation->getOp();
+        double counter = start.asNumber();
+        double bound = limit.asNumber();
+        bool guardFailed = false;
+
+        while (ClosureCompiler::compare(op, counter, bound)) {
+          Completion completion = body();
+          if (completion != Completion::NORMAL) {
+            return completion;
+          }
+
+          // the body may have grown the stack, so the slots are found anew
+          Value* slots = &in->stack[in->frame.stackBase];
+          Value current = slots[fusion.left.slot];
+          if (!current.isNumber() || current.asNumber() != counter ||
+              (fusion.right.slot != -1 &&
+               (!slots[fusion.right.slot].isNumber() ||
+                slots[fusion.right.slot].asNumber() != bound))) {
+            guardFailed = true;
+            deoptimized = true;
+            break;
+          }
+
+          counter += fusion.step;
+          slots[fusion.left.slot] = counter;
+        }
+
+        if (!guardFailed) {
+          return Completion::NORMAL;
+        }
+        increment();
+      }
+
+      while (condition()) {
+        Completion completion = body();
+        if (completion != Completion::NORMAL) {
+          return completion;
+        }
+        increment();
+      }
+      return Completion::NORMAL;
+    };
+  }
+
+  if (fusion.pattern == Pattern::COMPARE_BRANCH) {
+    return [in = &interpreter,
+            fusion,
+            body = ClosureCompiler::compile(_stmt.getBody())]() {
+      for (;;) {
+        in->fusionRuns[static_cast<int>(Pattern::COMPARE_BRANCH)]++;
+        if (!ClosureCompiler::compare(in, fusion)) {
+          return Completion::NORMAL;
+        }
+
+        Completion completion = body();
+        if (completion != Completion::NORMAL) {
+          return completion;
+        }
+      }
+    };
+  }
+
+  return [condition = ClosureCompiler::compileCondition(_stmt.getCondition()),
+          body = ClosureCompiler::compile(_stmt.getBody())]() {
+    while (condition()) {
+      Completion completion = body();
+      if (completion != Completion::NORMAL) {
+        return completion;
+      }
+    }
+    return Completion::NORMAL;
+  };
+}
+
+
+// assign expr
+
+CompiledExpr ClosureCompiler::visitAssignExpr(const lox::expr::Assign& _expr) {
+  const Fusion& fusion = interpreter.getFusion(_expr.getId());
+
+  if (fusion.pattern == Pattern::INCREMENT_LOCAL) {
+    return [in = &interpreter, fusion]() -> Value {
+      in->fusionRuns[static_cast<int>(Pattern::INCREMENT_LOCAL)]++;
+      Value& slot = in->stack[in->frame.stackBase + fusion.left.slot];
+
+      if (slot.isNumber()) {
+        slot = slot.asNumber() + fusion.right.constant;
+      } else {
+        slot = in->add(
+            fusion.operation->getOp(), slot, fusion.right.constant);
+      }
+      return slot;
+    };
+  }
+
+  return [value = ClosureCompiler::compile(_expr.getValue()),
+          assign = ClosureCompiler::compileAssign(
+              _expr.getId(), _expr.getName())]() {
+    Value result = value();
+    assign(result);
+    return result;
+  };
+}
+
+
+// binary expr
+//
+// Only operators that can use an object operand keep the left value rooted
+// while the right one is evaluated; the arithmetic and comparison forms
+// never dereference it. + and == carry the specialization they rewrote
+// themselves to in the closure; see TypeFeedback.h. Comparisons and
+// equality are built as conditions, and their value boxes the bool.
+
+#define NUMBER_BINARY(op)                                    \
+  [in, left, right, token]() -> Value {                      \
+    Value a = left();                                        \
+    Value b = right();                                       \
+    in->checkNumberOperands(token, a, b);                    \
+    return a.asNumber() op b.asNumber();                     \
+  }
+
+#define NUMBER_COMPARE(op)                                   \
+  ClosureCompiler::compileBool(                              \
+      _expr,                                                 \
+      [in, left, right, token]() {                           \
+        Value a = left();                                    \
+        Value b = right();                                   \
+        in->checkNumberOperands(token, a, b);                \
+        return a.asNumber() op b.asNumber();                 \
+      })
+
+CompiledExpr ClosureCompiler::visitBinaryExpr(const lox::expr::Binary& _expr) {
+  Interpreter* in = &interpreter;
+  CompiledExpr left = ClosureCompiler::compile(_expr.getLeft());
+  CompiledExpr right = ClosureCompiler::compile(_expr.getRight());
+  Token token = _expr.getOp();
+
+  switch (token.tokentype()) {
+    case TokenType::MINUS:
+      return NUMBER_BINARY(-);
+
+    case TokenType::SLASH:
+      return NUMBER_BINARY(/);
+
+    case TokenType::STAR:
+      return NUMBER_BINARY(*);
+
+    case TokenType::GREATER:
+      return NUMBER_COMPARE(>);
+
+    case TokenType::GREATER_EQUAL:
+      return NUMBER_COMPARE(>=);
+
+    case TokenType::LESS:
+      return NUMBER_COMPARE(<);
+
+    case TokenType::LESS_EQUAL:
+      return NUMBER_COMPARE(<=);
+
+    case TokenType::EQUAL_EQUAL:
+    case TokenType::BANG_EQUAL: {
+      bool negate = token.tokentype() == TokenType::BANG_EQUAL;
+
+      return ClosureCompiler::compileBool(
+          _expr,
+          [in,
+           left,
+           right,
+           negate,
+           node = Specialization::UNINITIALIZED]() mutable {
+            Value a = left();
+
+            if (node == Specialization::NUMBER && a.isNumber()) {
+              Value b = right();
+              if (b.isNumber()) {
+                return (a.asNumber() == b.asNumber()) != negate;
+              }
+              node = Specialization::GENERIC;
+              return in->isEqual(a, b) != negate;
+            }
+
+            TemporaryRoots roots(in->heap);
+            roots.push(a);
+            Value b = right();
+
+            if (node != Specialization::GENERIC) {
+              node = rewrite(node, a, b, false);
+            }
+            return in->isEqual(a, b) != negate;
+          });
+    }
+
+    case TokenType::PLUS:
+      return [in,
+              left,
+              right,
+              token,
+              node = Specialization::UNINITIALIZED]() mutable -> Value {
+        Value a = left();
+
+        // a number operand needs no rooting while the other is evaluated
+        if (node == Specialization::NUMBER && a.isNumber()) {
+          Value b = right();
+          if (b.isNumber()) {
+            return a.asNumber() + b.asNumber();
+          }
+          node = Specialization::GENERIC;
+          return in->add(token, a, b);
+        }
+
+        TemporaryRoots roots(in->heap);
+        roots.push(a);
+        Value b = right();
+
+        if (node == Specialization::STRING && a.is(ObjectType::OBJ_STRING) &&
+            b.is(ObjectType::OBJ_STRING)) {
+          return in->concatenate(a.as<LoxString>(), b.as<LoxString>());
+        }
+        if (node != Specialization::GENERIC) {
+          node = rewrite(node, a, b, true);
+        }
+        return in->add(token, a, b);
+      };
+
+    default:
+      return []() -> Value { return nullptr; };
+  }
+}
+
+#undef NUMBER_COMPARE
+#undef NUMBER_BINARY
+
+
+// call expr
+
+CompiledExpr ClosureCompiler::visitCallExpr(const lox::expr::Call& _expr) {
+  std::vector<CompiledExpr> arguments;
+  for (const lox::expr::Expr& argument : _expr.getArguments()) {
+    arguments.push_back(ClosureCompiler::compile(argument));
+  }
+
+  return [in = &interpreter,
+          callee = ClosureCompiler::compileCallee(_expr),
+          arguments = std::move(arguments),
+          paren = _expr.getParen()]() -> Value {
+    TemporaryRoots roots(in->heap);
+    Value receiver = nullptr;
+    Value function = callee(receiver, roots);
+
+    Arguments values;
+    for (const CompiledExpr& argument : arguments) {
+      values.push(argument());
+      roots.push(values.back());
+    }
+
+    return in->callValue(function, receiver, paren, values.values());
+  };
+}
+
+
+// a method call yields the method and its receiver separately, so the
+// receiver goes straight to the method; see Interpreter::evaluateCallee
+
+ClosureCompiler::Callee ClosureCompiler::compileCallee(
+    const lox::expr::Call& _expr) {
+  const lox::expr::Get* get = interpreter.getInvoke(_expr.getId());
+
+  if (get == nullptr) {
+    return [callee = ClosureCompiler::compile(_expr.getCallee())](
+               Value& receiver, TemporaryRoots& roots) -> Value {
+      Value function = callee();
+      roots.push(function);
+      return function;
+    };
+  }
+
+  return [in = &interpreter,
+          object = ClosureCompiler::compile(get->getObject()),
+          name = get->getName(),
+          property = get->getId(),
+          id = _expr.getId()](
+             Value& receiver, TemporaryRoots& roots) -> Value {
+    Value instance = object();
+    roots.push(instance);
+
+    if (!instance.is(ObjectType::OBJ_INSTANCE)) {
+      throw RuntimeError(name, "Only instances have properties.");
+    }
+
+    LoxInstance* target = instance.as<LoxInstance>();
+    LoxFunction* method = in->methodCaches.at(id).find(target, name);
+
+    if (method != nullptr) {
+      receiver = instance;
+      return method;
+    }
+
+    Value function =
+        in->propertyCaches.at(property).get(target, name, in->heap);
+    roots.push(function);
+    return function;
+  };
+}
+
+
+// get expr
+
+CompiledExpr ClosureCompiler::visitGetExpr(const lox::expr::Get& _expr) {
+  return [in = &interpreter,
+          object = ClosureCompiler::compile(_expr.getObject()),
+          name = _expr.getName(),
+          id = _expr.getId()]() -> Value {
+    Value instance = object();
+
+    if (!instance.is(ObjectType::OBJ_INSTANCE)) {
+      throw RuntimeError(name, "Only instances have properties.");
+    }
+
+    TemporaryRoots roots(in->heap);
+    roots.push(instance);
+    return in->propertyCaches.at(id).get(
+        instance.as<LoxInstance>(), name, in->heap);
+  };
+}
+
+
+// grouping expr
+
+CompiledExpr ClosureCompiler::visitGroupingExpr(
+    const lox::expr::Grouping& _expr) {
+  CompiledExpr value = ClosureCompiler::compile(_expr.getExpression());
+  const CompiledCondition& condition =
+      conditions[_expr.getExpression().getId()];
+
+  if (condition) {
+    conditions.set(_expr.getId(), condition);
+  }
+
+  return value;
+}
+
+
+// literal expr
+
+CompiledExpr ClosureCompiler::visitLiteralExpr(const lox::expr::Literal& _expr) {
+  Value value = interpreter.getConstant(_expr.getId());
+  conditions.set(
+      _expr.getId(),
+      [truth = interpreter.isTruthy(value)]() { return truth; });
+
+  return [value]() { return value; };
+}
+
+
+// logical expr
+
+CompiledExpr ClosureCompiler::visitLogicalExpr(
+    const lox::expr::Logical& _expr) {
+  Interpreter* in = &interpreter;
+  CompiledExpr left = ClosureCompiler::compile(_expr.getLeft());
+  CompiledExpr right = ClosureCompiler::compile(_expr.getRight());
+  CompiledCondition testLeft = ClosureCompiler::test(_expr.getLeft(), left);
+  CompiledCondition testRight = ClosureCompiler::test(_expr.getRight(), right);
+
+  // as a condition, only the truth of the operand that decides is needed
+  if (_expr.getOp().tokentype() == TokenType::OR) {
+    conditions.set(_expr.getId(), [testLeft, testRight]() {
+      return testLeft() || testRight();
+    });
+
+    return [in, left, right]() {
+      Value value = left();
+      return in->isTruthy(value) ? value : right();
+    };
+  }
+
+  conditions.set(_expr.getId(), [testLeft, testRight]() {
+    return testLeft() && testRight();
+  });
+
+  return [in, left, right]() {
+    Value value = left();
+    return in->isTruthy(value) ? right() : value;
+  };
+}
+
+
+// set expr
+
+CompiledExpr ClosureCompiler::visitSetExpr(const lox::expr::Set& _expr) {
+  const Fusion& fusion = interpreter.getFusion(_expr.getId());
+
+  if (fusion.pattern == Pattern::FIELD_UPDATE) {
+    return [in = &interpreter,
+            object = ClosureCompiler::compile(_expr.getObject()),
+            value = ClosureCompiler::compile(fusion.operation->getRight()),
+            name = _expr.getName(),
+            field = fusion.field->getName(),
+            op = fusion.operation->getOp(),
+            read = fusion.field->getId(),
+            write = _expr.getId()]() -> Value {
+      in->fusionRuns[static_cast<int>(Pattern::FIELD_UPDATE)]++;
+      Value instance = object();
+
+      if (!instance.is(ObjectType::OBJ_INSTANCE)) {
+        throw RuntimeError(name, "Only instances have fields.");
+      }
+
+      TemporaryRoots roots(in->heap);
+      roots.push(instance);
+      LoxInstance* target = instance.as<LoxInstance>();
+      Value current = in->propertyCaches.at(read).get(target, field, in->heap);
+      roots.push(current);
+
+      Value result = ClosureCompiler::arithmetic(in, op, current, value());
+      in->propertyCaches.at(write).set(target, name, result, in->heap);
+      return result;
+    };
+  }
+
+  return [in = &interpreter,
+          object = ClosureCompiler::compile(_expr.getObject()),
+          value = ClosureCompiler::compile(_expr.getValue()),
+          name = _expr.getName(),
+          id = _expr.getId()]() -> Value {
+    Value instance = object();
+
+    if (!instance.is(ObjectType::OBJ_INSTANCE)) {
+      throw RuntimeError(name, "Only instances have fields.");
+    }
+
+    TemporaryRoots roots(in->heap);
+    roots.push(instance);
+    Value result = value();
+    in->propertyCaches.at(id).set(
+        instance.as<LoxInstance>(), name, result, in->heap);
+    return result;
+  };
+}
+
+
+// super expr
+
+CompiledExpr ClosureCompiler::visitSuperExpr(const lox::expr::Super& _expr) {
+  return [in = &interpreter,
+          superclass =
+              ClosureCompiler::compileLoad(_expr.getId(), _expr.getKeyword()),
+          receiver = ClosureCompiler::compileLoad(
+              _expr.getThisId(), _expr.getKeyword()),
+          method = _expr.getMethod()]() -> Value {
+    LoxFunction* function =
+        superclass().as<LoxClass>()->findMethod(method.getLexeme());
+
+    if (function == nullptr) {
+      throw RuntimeError(
+          method, "Undefined property '" + method.getLexeme() + "'.");
+    }
+
+    return function->bind(receiver().as<LoxInstance>(), in->heap);
+  };
+}
+
+
+// this expr
+
+CompiledExpr ClosureCompiler::visitThisExpr(const lox::expr::This& _expr) {
+  return ClosureCompiler::compileLoad(_expr.getId(), _expr.getKeyword());
+}
+
+
+// unary expr
+
+CompiledExpr ClosureCompiler::visitUnaryExpr(const lox::expr::Unary& _expr) {
+  Interpreter* in = &interpreter;
+  CompiledExpr right = ClosureCompiler::compile(_expr.getRight());
+
+  if (_expr.getOp().tokentype() == TokenType::BANG) {
+    return ClosureCompiler::compileBool(
+        _expr,
+        [truth = ClosureCompiler::test(_expr.getRight(), right)]() {
+          return !truth();
+        });
+  }
+
+  return [in, right, token = _expr.getOp()]() -> Value {
+    Value value = right();
+    in->checkNumberOperand(token, value);
+    return -value.asNumber();
+  };
+}
+
+
+// variable expr
+
+CompiledExpr ClosureCompiler::visitVariableExpr(
+    const lox::expr::Variable& _expr) {
+  return ClosureCompiler::compileLoad(_expr.getId(), _expr.getName());
+}
+
+
+// fused steps
+
+Value ClosureCompiler::operand(Interpreter* in, const Operand& source) {
+  if (source.slot == -1) {
+    return source.constant;
+  }
+  return in->stack[in->frame.stackBase + source.slot];
+}
+
+
+bool ClosureCompiler::compare(Interpreter* in, const Fusion& fusion) {
+  Value a = ClosureCompiler::operand(in, fusion.left);
+  Value b = ClosureCompiler::operand(in, fusion.right);
+  const Token& op = fusion.operation->getOp();
+  in->checkNumberOperands(op, a, b);
+  return ClosureCompiler::compare(op, a.asNumber(), b.asNumber());
+}
+
+
+bool ClosureCompiler::compare(
+    const Token& op,
+    const double& a,
+    const double& b) {
+  switch (op.tokentype()) {
+    case TokenType::GREATER:
+      return a > b;
+
+    case TokenType::GREATER_EQUAL:
+      return a >= b;
+
+    case TokenType::LESS:
+      return a < b;
+
+    default:
+      return a <= b;
+  }
+}
+
+
+Value ClosureCompiler::arithmetic(
+    Interpreter* in,
+    const Token& op,
+    const Value& a,
+    const Value& b) {
+  if (op.tokentype() == TokenType::PLUS) {
+    if (a.isNumber() && b.isNumber()) {
+      return a.asNumber() + b.asNumber();
+    }
+    return in->add(op, a, b);
+  }
+
+  in->checkNumberOperands(op, a, b);
+
+  switch (op.tokentype()) {
+    case TokenType::MINUS:
+      return a.asNumber() - b.asNumber();
+
+    case TokenType::STAR:
+      return a.asNumber() * b.asNumber();
+
+    default:
+      return a.asNumber() / b.asNumber();
+  }
+}
+
+
+// variable access, specialized on where the resolver put the name
+
+CompiledExpr ClosureCompiler::compileLoad(const int& node, const Token& name) {
+  Interpreter* in = &interpreter;
+  const Binding& binding = interpreter.getBinding(node);
+  int index = binding.index;
+
+  switch (binding.kind) {
+    case BindingKind::STACK:
+      return [in, index]() { return in->stack[in->frame.stackBase + index]; };
+
+    case BindingKind::CELL:
+      return [in, index]() {
+        return in->cells[in->frame.cellBase + index]->get();
+      };
+
+    case BindingKind::UPVALUE:
+      return [in, index]() { return (*in->frame.upvalues)[index]->get(); };
+
+    default:
+      return [in, index, name]() { return in->globals.get(index, name); };
+  }
+}
+
+
+ClosureCompiler::Setter ClosureCompiler::compileAssign(
+    const int& node,
+    const Token& name) {
+  const Binding& binding = interpreter.getBinding(node);
+
+  if (binding.kind == BindingKind::GLOBAL) {
+    return [in = &interpreter, index = binding.index, name](
+               const Value& value) { in->globals.assign(index, name, value); };
+  }
+
+  return ClosureCompiler::compileStore(node);
+}
+
+
+// a captured local gets a fresh cell each time its declaration runs
+
+ClosureCompiler::Setter ClosureCompiler::compileDefine(const int& node) {
+  Interpreter* in = &interpreter;
+  const Binding& binding = interpreter.getBinding(node);
+  int index = binding.index;
+
+  switch (binding.kind) {
+    case BindingKind::CELL:
+      return [in, index](const Value& value) {
+        in->cellPool.define(in->cells[in->frame.cellBase + index], value);
+      };
+
+    case BindingKind::GLOBAL:
+      return [in, index](const Value& value) {
+        in->globals.define(index, value);
+      };
+
+    default:
+      return ClosureCompiler::compileStore(node);
+  }
+}
+
+
+ClosureCompiler::Setter ClosureCompiler::compileStore(const int& node) {
+  Interpreter* in = &interpreter;
+  const Binding& binding = interpreter.getBinding(node);
+  int index = binding.index;
+
+  switch (binding.kind) {
+    case BindingKind::STACK:
+      return [in, index](const Value& value) {
+        in->stack[in->frame.stackBase + index] = value;
+      };
+
+    case BindingKind::CELL:
+      return [in, index](const Value& value) {
+        const auto& cell = in->cells[in->frame.cellBase + index];
+        in->heap.writeBarrier(cell, value);
+        cell->set(value);
+      };
+
+    case BindingKind::UPVALUE:
+      return [in, index](const Value& value) {
+        const auto& cell = (*in->frame.upvalues)[index];
+        in->heap.writeBarrier(cell, value);
+        cell->set(value);
+      };
+
+    case BindingKind::GLOBAL:
+      return [in, index](const Value& value) {
+        in->globals.define(index, value);
+      };
+
+    default:
+      return [](const Value&) {};
+  }
+}
+
+}  // namespace lox
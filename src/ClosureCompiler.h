@@ -0,0 +1,96 @@
+#ifndef CLOSURECOMPILER_H
+#define CLOSURECOMPILER_H
+
+#include <functional>
+#include <vector>
+
+#include "Expr.h"
+#include "Interpreter.h"
+#include "SideTable.h"
+#include "Stmt.h"
+#include "Token.h"
+#include "Value.h"
+
+
+namespace lox {
+
+// Converts every resolved node once into a C++ callable that does exactly
+// that node's work: where a variable lives, which operator a binary node
+// applies and which branches exist are all decided here, not on each
+// execution. Function bodies are handed to the interpreter, which runs
+// them in place of re-walking the statements.
+
+class ClosureCompiler : public lox::expr::Visitor<CompiledExpr>,
+                        public lox::stmt::Visitor<CompiledStmt> {
+ private:
+  using Setter = std::function<void(const Value&)>;
+  // yields a call's callee, setting the receiver when it is a method
+  using Callee = std::function<Value(Value& receiver, TemporaryRoots& roots)>;
+
+  lox::Interpreter& interpreter;
+  // the condition form of the nodes whose result is a bool, by node
+  SideTable<CompiledCondition> conditions;
+
+  CompiledCondition test(
+      const lox::expr::Expr& _expr,
+      const CompiledExpr& value) const;
+
+  // the work of the fused steps; see Fuser
+  static Value operand(Interpreter* in, const Operand& source);
+  static bool compare(Interpreter* in, const Fusion& fusion);
+  static bool compare(const Token& op, const double& a, const double& b);
+  static Value arithmetic(
+      Interpreter* in,
+      const Token& op,
+      const Value& a,
+      const Value& b);
+
+ public:
+  ClosureCompiler(lox::Interpreter& interpreter);
+  CompiledStmt compile(const std::vector<lox::stmt::Stmt>& statements);
+
+  CompiledStmt visitBlockStmt(const lox::stmt::Block& _stmt);
+  CompiledStmt visitClassStmt(const lox::stmt::Class& _stmt);
+  CompiledStmt visitExpressionStmt(const lox::stmt::Expression& _stmt);
+  CompiledStmt visitFunctionStmt(const lox::stmt::Function& _stmt);
+  CompiledStmt visitIfStmt(const lox::stmt::If& _stmt);
+  CompiledStmt visitPrintStmt(const lox::stmt::Print& _stmt);
+  CompiledStmt visitReturnStmt(const lox::stmt::Return& _stmt);
+  CompiledStmt visitVarStmt(const lox::stmt::Var& _stmt);
+  CompiledStmt visitWhileStmt(const lox::stmt::While& _stmt);
+
+  CompiledExpr visitAssignExpr(const lox::expr::Assign& _expr);
+  CompiledExpr visitBinaryExpr(const lox::expr::Binary& _expr);
+  CompiledExpr visitCallExpr(const lox::expr::Call& _expr);
+  CompiledExpr visitGetExpr(const lox::expr::Get& _expr);
+  CompiledExpr visitGroupingExpr(const lox::expr::Grouping& _expr);
+  CompiledExpr visitLiteralExpr(const lox::expr::Literal& _expr);
+  CompiledExpr visitLogicalExpr(const lox::expr::Logical& _expr);
+  CompiledExpr visitSetExpr(const lox::expr::Set& _expr);
+  CompiledExpr visitSuperExpr(const lox::expr::Super& _expr);
+  CompiledExpr visitThisExpr(const lox::expr::This& _expr);
+  CompiledExpr visitUnaryExpr(const lox::expr::Unary& _expr);
+  CompiledExpr visitVariableExpr(const lox::expr::Variable& _expr);
+
+  CompiledStmt compile(const lox::stmt::Stmt& _stmt);
+  CompiledExpr compile(const lox::expr::Expr& _expr);
+  CompiledCondition compileCondition(const lox::expr::Expr& _expr);
+  CompiledExpr compileBool(
+      const lox::expr::Expr& _expr,
+      const CompiledCondition& condition);
+  CompiledStmt compileBlock(const std::vector<lox::stmt::Stmt>& statements);
+  void compileInline(
+      const std::vector<lox::stmt::Stmt>& statements,
+      std::vector<CompiledStmt>& body);
+  void compileBody(const lox::stmt::Function& function);
+  Callee compileCallee(const lox::expr::Call& _expr);
+
+  CompiledExpr compileLoad(const int& node, const Token& name);
+  Setter compileAssign(const int& node, const Token& name);
+  Setter compileDefine(const int& node);
+  Setter compileStore(const int& node);
+};
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,617 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Chunk.h"
+#include "Compiler.h"
+#include "Expr.h"
+#include "Interpreter.h"
+#include "Lox.h"
+#include "Stmt.h"
+#include "Token.h"
+#include "TokenType.h"
+#include "Value.h"
+
+
+namespace lox {
+
+Compiler::Compiler(const lox::Interpreter& interpreter)
+    : interpreter(interpreter) {}
+
+
+// compile the script; function prototypes are added as they are reached
+
+Program Compiler::compile(const std::vector<lox::stmt::Stmt>& statements) {
+  program.prototypes.push_back(std::make_unique<Prototype>());
+  current = program.prototypes.back().get();
+  current->name = "script";
+  current->layout = interpreter.getFrameLayout(-1);
+
+  for (const lox::stmt::Stmt& statement : statements) {
+    Compiler::compile(statement);
+  }
+
+  Compiler::emit(OpCode::OP_NIL);
+  Compiler::emit(OpCode::OP_RETURN);
+
+  current = nullptr;
+  return std::move(program);
+}
+
+
+void Compiler::compile(const lox::stmt::Stmt& _stmt) {
+  _stmt.accept(*this);
+}
+
+
+void Compiler::compile(const lox::expr::Expr& _expr) {
+  _expr.accept(*this);
+}
+
+
+// function
+//
+// Arguments arrive in the callee's first stack slots, after the receiver
+// for methods. The prologue moves any that closures capture into cells.
+
+int Compiler::compileFunction(
+    const lox::stmt::Function& function,
+    const bool& isMethod,
+    const bool& isInitializer) {
+  program.prototypes.push_back(std::make_unique<Prototype>());
+  int index = program.prototypes.size() - 1;
+
+  Prototype* prototype = program.prototypes.back().get();
+  prototype->declaration = &function;
+  prototype->name = function.getName().getLexeme();
+  prototype->arity = function.getParams().size();
+  prototype->isMethod = isMethod;
+  prototype->isInitializer = isInitializer;
+  prototype->layout = interpreter.getFrameLayout(function.getId());
+  prototype->captures = interpreter.getCaptures(function.getId());
+  program.functions.set(function.getId(), prototype);
+
+  Prototype* enclosing = current;
+  current = prototype;
+  line = function.getName().getLine();
+
+  int slot = 0;
+  std::vector<int> arguments;
+  if (isMethod) {
+    arguments.push_back(function.getId());
+  }
+  for (std::size_t i = 0; i < function.getParams().size(); i++) {
+    arguments.push_back(function.getParamId(i));
+  }
+
+  for (const int& node : arguments) {
+    const Binding& binding = interpreter.getBinding(node);
+    if (binding.kind == BindingKind::CELL) {
+      Compiler::emit(OpCode::OP_GET_LOCAL, slot);
+      Compiler::emit(OpCode::OP_DEFINE_CELL, binding.index);
+    }
+    slot++;
+  }
+
+  for (const lox::stmt::Stmt& statement : function.getBody()) {
+    Compiler::compile(statement);
+  }
+
+  Compiler::emit(OpCode::OP_NIL);
+  Compiler::emit(OpCode::OP_RETURN);
+
+  current = enclosing;
+  return index;
+}
+
+
+// block stmt
+
+void Compiler::visitBlockStmt(const lox::stmt::Block& _stmt) {
+  for (const lox::stmt::Stmt& statement : _stmt.getStatements()) {
+    Compiler::compile(statement);
+  }
+}
+
+
+// class stmt
+//
+// The class name is bound before the methods close over it; the CLASS
+// instruction collects the method closures and the superclass from the
+// stack.
+
+void Compiler::visitClassStmt(const lox::stmt::Class& _stmt) {
+  line = _stmt.getName().getLine();
+
+  Compiler::emit(OpCode::OP_NIL);
+  Compiler::emitDefine(_stmt.getId(), _stmt.getName());
+
+  bool hasSuperclass = _stmt.getSuperclass() != nullptr;
+
+  if (hasSuperclass) {
+    Compiler::compile(_stmt.getSuperclass());
+    Compiler::emitDefine(_stmt.getSuperId(), _stmt.getSuperclass().getName());
+  }
+
+  for (const lox::stmt::Function& method : _stmt.getMethods()) {
+    int index = Compiler::compileFunction(
+        method, true, method.getName().getLexeme() == "init");
+    Compiler::emit(OpCode::OP_CLOSURE, index);
+  }
+
+  if (hasSuperclass) {
+    Compiler::emitLoad(_stmt.getSuperId(), _stmt.getSuperclass().getName());
+  }
+
+  line = _stmt.getName().getLine();
+  Compiler::emit(OpCode::OP_CLASS, Compiler::makeName(_stmt.getName()));
+  Compiler::emitByte(_stmt.getMethods().size() >> 8);
+  Compiler::emitByte(_stmt.getMethods().size() & 0xff);
+  Compiler::emitByte(hasSuperclass ? 1 : 0);
+
+  Compiler::emitStore(_stmt.getId(), _stmt.getName());
+}
+
+
+// expression stmt
+
+void Compiler::visitExpressionStmt(const lox::stmt::Expression& _stmt) {
+  Compiler::compile(_stmt.getExpression());
+  Compiler::emit(OpCode::OP_POP);
+}
+
+
+// function stmt
+
+void Compiler::visitFunctionStmt(const lox::stmt::Function& _stmt) {
+  line = _stmt.getName().getLine();
+
+  // the name is in scope first, so a recursive function can capture itself
+  Compiler::emit(OpCode::OP_NIL);
+  Compiler::emitDefine(_stmt.getId(), _stmt.getName());
+
+  int index = Compiler::compileFunction(_stmt, false, false);
+
+  line = _stmt.getName().getLine();
+  Compiler::emit(OpCode::OP_CLOSURE, index);
+  Compiler::emitStore(_stmt.getId(), _stmt.getName());
+}
+
+
+// if stmt
+
+void Compiler::visitIfStmt(const lox::stmt::If& _stmt) {
+  Compiler::compile(_stmt.getCondition());
+
+  std::size_t thenJump = Compiler::emitJump(OpCode::OP_JUMP_IF_FALSE);
+  Compiler::emit(OpCode::OP_POP);
+  Compiler::compile(_stmt.getThenBranch());
+
+  std::size_t elseJump = Compiler::emitJump(OpCode::OP_JUMP);
+  Compiler::patchJump(thenJump);
+  Compiler::emit(OpCode::OP_POP);
+
+  if (_stmt.getElseBranch() != nullptr) {
+    Compiler::compile(_stmt.getElseBranch());
+  }
+
+  Compiler::patchJump(elseJump);
+}
+
+
+// print stmt
+
+void Compiler::visitPrintStmt(const lox::stmt::Print& _stmt) {
+  Compiler::compile(_stmt.getExpression());
+  Compiler::emit(OpCode::OP_PRINT);
+}
+
+
+// return stmt
+
+void Compiler::visitReturnStmt(const lox::stmt::Return& _stmt) {
+  line = _stmt.getKeyword().getLine();
+
+  // the callee takes over this frame; the RETURN only runs when the call
+  // builds an instance instead
+  if (const lox::expr::Call* call = interpreter.getTailCall(_stmt.getId())) {
+    Compiler::emitCall(*call, OpCode::OP_TAIL_CALL);
+    Compiler::emit(OpCode::OP_RETURN);
+    return;
+  }
+
+  if (_stmt.getValue() != nullptr) {
+    Compiler::compile(_stmt.getValue());
+  } else {
+    Compiler::emit(OpCode::OP_NIL);
+  }
+
+  Compiler::emit(OpCode::OP_RETURN);
+}
+
+
+// var stmt
+
+void Compiler::visitVarStmt(const lox::stmt::Var& _stmt) {
+  line = _stmt.getName().getLine();
+
+  if (_stmt.getInitializer() != nullptr) {
+    Compiler::compile(_stmt.getInitializer());
+  } else {
+    Compiler::emit(OpCode::OP_NIL);
+  }
+
+  Compiler::emitDefine(_stmt.getId(), _stmt.getName());
+}
+
+
+// while stmt
+
+void Compiler::visitWhileStmt(const lox::stmt::While& _stmt) {
+  std::size_t start = current->chunk.size();
+  Compiler::compile(_stmt.getCondition());
+
+  std::size_t exitJump = Compiler::emitJump(OpCode::OP_JUMP_IF_FALSE);
+  Compiler::emit(OpCode::OP_POP);
+  Compiler::compile(_stmt.getBody());
+  Compiler::emitLoop(start);
+
+  Compiler::patchJump(exitJump);
+  Compiler::emit(OpCode::OP_POP);
+}
+
+
+// assign expr
+
+void Compiler::visitAssignExpr(const lox::expr::Assign& _expr) {
+  Compiler::compile(_expr.getValue());
+  line = _expr.getName().getLine();
+  Compiler::emitAssign(_expr.getId(), _expr.getName());
+}
+
+
+// binary expr
+
+void Compiler::visitBinaryExpr(const lox::expr::Binary& _expr) {
+  Compiler::compile(_expr.getLeft());
+  Compiler::compile(_expr.getRight());
+  line = _expr.getOp().getLine();
+
+  switch (_expr.getOp().tokentype()) {
+    case TokenType::BANG_EQUAL:
+      Compiler::emit(OpCode::OP_EQUAL);
+      Compiler::emit(OpCode::OP_NOT);
+      break;
+
+    case TokenType::EQUAL_EQUAL:
+      Compiler::emit(OpCode::OP_EQUAL);
+      break;
+
+    case TokenType::GREATER:
+      Compiler::emit(OpCode::OP_GREATER);
+      break;
+
+    case TokenType::GREATER_EQUAL:
+      Compiler::emit(OpCode::OP_GREATER_EQUAL);
+      break;
+
+    case TokenType::LESS:
+      Compiler::emit(OpCode::OP_LESS);
+      break;
+
+    case TokenType::LESS_EQUAL:
+      Compiler::emit(OpCode::OP_LESS_EQUAL);
+      break;
+
+    case TokenType::PLUS:
+      Compiler::emit(OpCode::OP_ADD);
+      break;
+
+    case TokenType::MINUS:
+      Compiler::emit(OpCode::OP_SUBTRACT);
+      break;
+
+    case TokenType::STAR:
+      Compiler::emit(OpCode::OP_MULTIPLY);
+      break;
+
+    case TokenType::SLASH:
+      Compiler::emit(OpCode::OP_DIVIDE);
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+// call expr
+
+void Compiler::visitCallExpr(const lox::expr::Call& _expr) {
+  Compiler::emitCall(_expr, OpCode::OP_CALL);
+}
+
+
+// get expr
+
+void Compiler::visitGetExpr(const lox::expr::Get& _expr) {
+  Compiler::compile(_expr.getObject());
+  line = _expr.getName().getLine();
+  Compiler::emit(OpCode::OP_GET_PROPERTY, Compiler::makeName(_expr.getName()));
+}
+
+
+// grouping expr
+
+void Compiler::visitGroupingExpr(const lox::expr::Grouping& _expr) {
+  Compiler::compile(_expr.getExpression());
+}
+
+
+// literal expr
+
+void Compiler::visitLiteralExpr(const lox::expr::Literal& _expr) {
+  const Value& value = interpreter.getConstant(_expr.getId());
+
+  if (value.isNil()) {
+    Compiler::emit(OpCode::OP_NIL);
+  } else if (value.isBool()) {
+    Compiler::emit(value.asBool() ? OpCode::OP_TRUE : OpCode::OP_FALSE);
+  } else {
+    Compiler::emit(OpCode::OP_CONSTANT, Compiler::makeConstant(value));
+  }
+}
+
+
+// logical expr
+
+void Compiler::visitLogicalExpr(const lox::expr::Logical& _expr) {
+  Compiler::compile(_expr.getLeft());
+
+  if (_expr.getOp().tokentype() == TokenType::OR) {
+    std::size_t elseJump = Compiler::emitJump(OpCode::OP_JUMP_IF_FALSE);
+    std::size_t endJump = Compiler::emitJump(OpCode::OP_JUMP);
+
+    Compiler::patchJump(elseJump);
+    Compiler::emit(OpCode::OP_POP);
+    Compiler::compile(_expr.getRight());
+    Compiler::patchJump(endJump);
+    return;
+  }
+
+  std::size_t endJump = Compiler::emitJump(OpCode::OP_JUMP_IF_FALSE);
+  Compiler::emit(OpCode::OP_POP);
+  Compiler::compile(_expr.getRight());
+  Compiler::patchJump(endJump);
+}
+
+
+// set expr
+
+void Compiler::visitSetExpr(const lox::expr::Set& _expr) {
+  Compiler::compile(_expr.getObject());
+  Compiler::compile(_expr.getValue());
+  line = _expr.getName().getLine();
+  Compiler::emit(OpCode::OP_SET_PROPERTY, Compiler::makeName(_expr.getName()));
+}
+
+
+// super expr
+
+void Compiler::visitSuperExpr(const lox::expr::Super& _expr) {
+  line = _expr.getKeyword().getLine();
+  Compiler::emitLoad(_expr.getThisId(), _expr.getKeyword());
+  Compiler::emitLoad(_expr.getId(), _expr.getKeyword());
+  Compiler::emit(OpCode::OP_GET_SUPER, Compiler::makeName(_expr.getMethod()));
+}
+
+
+// this expr
+
+void Compiler::visitThisExpr(const lox::expr::This& _expr) {
+  line = _expr.getKeyword().getLine();
+  Compiler::emitLoad(_expr.getId(), _expr.getKeyword());
+}
+
+
+// unary expr
+
+void Compiler::visitUnaryExpr(const lox::expr::Unary& _expr) {
+  Compiler::compile(_expr.getRight());
+  line = _expr.getOp().getLine();
+
+  if (_expr.getOp().tokentype() == TokenType::BANG) {
+    Compiler::emit(OpCode::OP_NOT);
+  } else {
+    Compiler::emit(OpCode::OP_NEGATE);
+  }
+}
+
+
+// variable expr
+
+void Compiler::visitVariableExpr(const lox::expr::Variable& _expr) {
+  line = _expr.getName().getLine();
+  Compiler::emitLoad(_expr.getId(), _expr.getName());
+}
+
+
+// emitting
+
+void Compiler::emit(const OpCode& op) {
+  current->chunk.write(op, line);
+}
+
+
+void Compiler::emit(const OpCode& op, const int& operand) {
+  current->chunk.write(op, line);
+  current->chunk.writeShort(operand, line);
+}
+
+
+void Compiler::emitByte(const int& byte) {
+  current->chunk.write(static_cast<std::uint8_t>(byte), line);
+}
+
+
+std::size_t Compiler::emitJump(const OpCode& op) {
+  Compiler::emit(op, 0xffff);
+  return current->chunk.size() - 2;
+}
+
+
+void Compiler::patchJump(const std::size_t& offset) {
+  std::size_t jump = current->chunk.size() - offset - 2;
+
+  if (jump > UINT16_MAX) {
+    Lox _lox;
+    _lox.error(line, "Too much code to jump over.");
+  }
+
+  current->chunk.patchShort(offset, jump);
+}
+
+
+void Compiler::emitCall(const lox::expr::Call& call, const OpCode& op) {
+  Compiler::compile(call.getCallee());
+
+  for (const lox::expr::Expr& argument : call.getArguments()) {
+    Compiler::compile(argument);
+  }
+
+  line = call.getParen().getLine();
+  Compiler::emit(op);
+  Compiler::emitByte(call.getArguments().size());
+}
+
+
+void Compiler::emitLoop(const std::size_t& start) {
+  std::size_t offset = current->chunk.size() + 3 - start;
+
+  if (offset > UINT16_MAX) {
+    Lox _lox;
+    _lox.error(line, "Loop body too large.");
+  }
+
+  Compiler::emit(OpCode::OP_LOOP, offset);
+}
+
+
+// variables
+//
+// load and assign leave the value on the stack; define and store consume it.
+// Storing differs from assigning only for globals, where a declaration may
+// run before any definition exists.
+
+void Compiler::emitLoad(const int& node, const Token& name) {
+  const Binding& binding = interpreter.getBinding(node);
+
+  switch (binding.kind) {
+    case BindingKind::STACK:
+      Compiler::emit(OpCode::OP_GET_LOCAL, binding.index);
+      break;
+
+    case BindingKind::CELL:
+      Compiler::emit(OpCode::OP_GET_CELL, binding.index);
+      break;
+
+    case BindingKind::UPVALUE:
+      Compiler::emit(OpCode::OP_GET_UPVALUE, binding.index);
+      break;
+
+    default:
+      Compiler::emit(OpCode::OP_GET_GLOBAL, binding.index);
+      current->chunk.writeShort(Compiler::makeName(name), line);
+  }
+}
+
+
+void Compiler::emitAssign(const int& node, const Token& name) {
+  const Binding& binding = interpreter.getBinding(node);
+
+  switch (binding.kind) {
+    case BindingKind::STACK:
+      Compiler::emit(OpCode::OP_SET_LOCAL, binding.index);
+      break;
+
+    case BindingKind::CELL:
+      Compiler::emit(OpCode::OP_SET_CELL, binding.index);
+      break;
+
+    case BindingKind::UPVALUE:
+      Compiler::emit(OpCode::OP_SET_UPVALUE, binding.index);
+      break;
+
+    default:
+      Compiler::emit(OpCode::OP_SET_GLOBAL, binding.index);
+      current->chunk.writeShort(Compiler::makeName(name), line);
+  }
+}
+
+
+void Compiler::emitDefine(const int& node, const Token& name) {
+  const Binding& binding = interpreter.getBinding(node);
+
+  switch (binding.kind) {
+    case BindingKind::STACK:
+      Compiler::emit(OpCode::OP_DEFINE_LOCAL, binding.index);
+      break;
+
+    case BindingKind::CELL:
+      Compiler::emit(OpCode::OP_DEFINE_CELL, binding.index);
+      break;
+
+    case BindingKind::UPVALUE:
+      Compiler::emit(OpCode::OP_SET_UPVALUE, binding.index);
+      Compiler::emit(OpCode::OP_POP);
+      break;
+
+    default:
+      Compiler::emit(OpCode::OP_DEFINE_GLOBAL, binding.index);
+      current->chunk.writeShort(Compiler::makeName(name), line);
+  }
+}
+
+
+void Compiler::emitStore(const int& node, const Token& name) {
+  const Binding& binding = interpreter.getBinding(node);
+
+  if (binding.kind == BindingKind::CELL) {
+    Compiler::emit(OpCode::OP_SET_CELL, binding.index);
+    Compiler::emit(OpCode::OP_POP);
+    return;
+  }
+
+  Compiler::emitDefine(node, name);
+}
+
+
+// operand tables
+
+int Compiler::makeConstant(const Value& value) {
+  int index = current->chunk.addConstant(value);
+
+  if (index > UINT16_MAX) {
+    Lox _lox;
+    _lox.error(line, "Too many constants in one chunk.");
+    return 0;
+  }
+
+  return index;
+}
+
+
+int Compiler::makeName(const Token& name) {
+  int index = current->chunk.addName(name);
+
+  if (index > UINT16_MAX) {
+    Lox _lox;
+    _lox.error(line, "Too many names in one chunk.");
+    return 0;
+  }
+
+  return index;
+}
+
+}  // namespace lox
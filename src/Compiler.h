@@ -0,0 +1,107 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Chunk.h"
+#include "Expr.h"
+#include "Interpreter.h"
+#include "SideTable.h"
+#include "Stmt.h"
+#include "Token.h"
+
+
+namespace lox {
+
+// A function compiled to bytecode. Closures made from it at runtime are
+// ordinary LoxFunction objects; the VM finds the prototype through the
+// declaration's node ID.
+
+struct Prototype {
+  const lox::stmt::Function* declaration = nullptr;
+  std::string name;
+  int arity = 0;
+  bool isMethod = false;
+  bool isInitializer = false;
+  FrameLayout layout;
+  std::vector<Capture> captures;
+  Chunk chunk;
+};
+
+
+struct Program {
+  // the top-level script comes first
+  std::vector<std::unique_ptr<Prototype>> prototypes;
+  SideTable<const Prototype*> functions;
+};
+
+
+// Compiles a resolved program to bytecode. Variable access uses the bindings
+// the resolver recorded in the interpreter, so both engines agree on where
+// every name lives.
+
+class Compiler : public lox::expr::Visitor<void>,
+                 public lox::stmt::Visitor<void> {
+ private:
+  const lox::Interpreter& interpreter;
+  Program program;
+  Prototype* current = nullptr;
+  int line = 0;
+
+ public:
+  Compiler(const lox::Interpreter& interpreter);
+  Program compile(const std::vector<lox::stmt::Stmt>& statements);
+
+  void visitBlockStmt(const lox::stmt::Block& _stmt);
+  void visitClassStmt(const lox::stmt::Class& _stmt);
+  void visitExpressionStmt(const lox::stmt::Expression& _stmt);
+  void visitFunctionStmt(const lox::stmt::Function& _stmt);
+  void visitIfStmt(const lox::stmt::If& _stmt);
+  void visitPrintStmt(const lox::stmt::Print& _stmt);
+  void visitReturnStmt(const lox::stmt::Return& _stmt);
+  void visitVarStmt(const lox::stmt::Var& _stmt);
+  void visitWhileStmt(const lox::stmt::While& _stmt);
+
+  void visitAssignExpr(const lox::expr::Assign& _expr);
+  void visitBinaryExpr(const lox::expr::Binary& _expr);
+  void visitCallExpr(const lox::expr::Call& _expr);
+  void visitGetExpr(const lox::expr::Get& _expr);
+  void visitGroupingExpr(const lox::expr::Grouping& _expr);
+  void visitLiteralExpr(const lox::expr::Literal& _expr);
+  void visitLogicalExpr(const lox::expr::Logical& _expr);
+  void visitSetExpr(const lox::expr::Set& _expr);
+  void visitSuperExpr(const lox::expr::Super& _expr);
+  void visitThisExpr(const lox::expr::This& _expr);
+  void visitUnaryExpr(const lox::expr::Unary& _expr);
+  void visitVariableExpr(const lox::expr::Variable& _expr);
+
+  void compile(const lox::stmt::Stmt& _stmt);
+  void compile(const lox::expr::Expr& _expr);
+  int compileFunction(
+      const lox::stmt::Function& function,
+      const bool& isMethod,
+      const bool& isInitializer);
+
+  void emit(const OpCode& op);
+  void emit(const OpCode& op, const int& operand);
+  void emitByte(const int& byte);
+  std::size_t emitJump(const OpCode& op);
+  void patchJump(const std::size_t& offset);
+  void emitLoop(const std::size_t& start);
+  void emitCall(const lox::expr::Call& call, const OpCode& op);
+
+  void emitLoad(const int& node, const Token& name);
+  void emitAssign(const int& node, const Token& name);
+  void emitDefine(const int& node, const Token& name);
+  void emitStore(const int& node, const Token& name);
+
+  int makeConstant(const Value& value);
+  int makeName(const Token& name);
+};
+
+}  // namespace lox
+
+#endif
@@ -6,21 +6,13 @@
 #include "Token.h"
 
 
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
-
 namespace lox {
 
 
 // assign
 
 lox::expr::Assign::Assign(const Token& name, const lox::expr::Expr& value)
-    : name(name), value(value) {}
-
-
-template <class T>
-const T lox::expr::Assign::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitAssignExpr(*this);
-}
+    : Expr(Kind::ASSIGN), name(name), value(value) {}
 
 
 // binary
@@ -29,13 +21,7 @@ lox::expr::Binary::Binary(
     const lox::expr::Expr& left,
     const Token& op,
     const lox::expr::Expr& right)
-    : left(left), op(op), right(right) {}
-
-
-template <class T>
-const T lox::expr::Binary::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitBinaryExpr(*this);
-}
+    : Expr(Kind::BINARY), left(left), op(op), right(right) {}
 
 
 // call
@@ -44,60 +30,29 @@ lox::expr::Call::Call(
     const lox::expr::Expr& callee,
     const Token& paren,
     const std::vector<lox::expr::Expr>& arguments)
-    : callee(callee), paren(paren), arguments(arguments) {}
-
-
-template <class T>
-const T lox::expr::Call::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitCallExpr(*this);
-}
+    : Expr(Kind::CALL), callee(callee), paren(paren), arguments(arguments) {}
 
 
 // get
 
 lox::expr::Get::Get(const lox::expr::Expr& object, const Token& name)
-    : object(object), name(name) {}
-
-
-template <class T>
-const T lox::expr::Get::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitGetExpr(*this);
-}
+    : Expr(Kind::GET), object(object), name(name) {}
 
 
 // grouping
 
 lox::expr::Grouping::Grouping(const lox::expr::Expr& expression)
-    : expression(expression) {}
-
-
-template <class T>
-const T lox::expr::Grouping::accept(
-    const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitGroupingExpr(*this);
-}
+    : Expr(Kind::GROUPING), expression(expression) {}
 
 
 // literal
 
-lox::expr::Literal::Literal(const Object& value)
-    : value([&value]() {
-        if (const auto* str = std::get_if<std::string>(&value)) {
-          return *str;
-        } else if (const auto* dbl = std::get_if<double>(&value)) {
-          return std::to_string(*dbl);
-        } else if (const auto* b = std::get_if<bool>(&value)) {
-          return std::string(*b ? "true" : "false");
-        } else {
-          return std::string("null");
-        }
-      }()) {}
+lox::expr::Literal::Literal(const Value& value)
+    : Expr(Kind::LITERAL), value(value) {}
 
 
-template <class T>
-const T lox::expr::Literal::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitLiteralExpr(*this);
-}
+lox::expr::Literal::Literal(const Token& string)
+    : Expr(Kind::LITERAL), text(&std::get<std::string>(string.getLiteral())) {}
 
 
 // logical
@@ -106,13 +61,7 @@ lox::expr::Logical::Logical(
     const lox::expr::Expr& left,
     const Token& op,
     const lox::expr::Expr& right)
-    : left(left), op(op), right(right) {}
-
-
-template <class T>
-const T lox::expr::Logical::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitLogicalExpr(*this);
-}
+    : Expr(Kind::LOGICAL), left(left), op(op), right(right) {}
 
 
 // set
@@ -121,59 +70,31 @@ lox::expr::Set::Set(
     const lox::expr::Expr& object,
     const Token& name,
     const lox::expr::Expr& value)
-    : object(object), name(name), value(value) {}
-
-
-template <class T>
-const T lox::expr::Set::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitSetExpr(*this);
-}
+    : Expr(Kind::SET), object(object), name(name), value(value) {}
 
 
 // super
 
 lox::expr::Super::Super(const Token& keyword, const Token& method)
-    : keyword(keyword), method(method) {}
-
-
-template <class T>
-const T lox::expr::Super::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitSuperExpr(*this);
-}
+    : Expr(Kind::SUPER), keyword(keyword), method(method) {}
 
 
 // this
 
-lox::expr::This::This(const Token& keyword) : keyword(keyword) {}
-
-
-template <class T>
-const T lox::expr::This::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitThisExpr(*this);
-}
+lox::expr::This::This(const Token& keyword)
+    : Expr(Kind::THIS), keyword(keyword) {}
 
 
 // unary
 
 lox::expr::Unary::Unary(const Token& op, const lox::expr::Expr& right)
-    : op(op), right(right) {}
-
-
-template <class T>
-const T lox::expr::Unary::accept(const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitUnaryExpr(*this);
-}
+    : Expr(Kind::UNARY), op(op), right(right) {}
 
 
 // variable
 
-lox::expr::Variable::Variable(const Token& name) : name(name) {}
-
+lox::expr::Variable::Variable(const Token& name)
+    : Expr(Kind::VARIABLE), name(name) {}
 
-template <class T>
-const T lox::expr::Variable::accept(
-    const lox::expr::Visitor<T>& visitor) const {
-  return visitor.visitVariableExpr(*this);
-}
 
 }  // namespace lox
@@ -4,14 +4,12 @@
 #define EXPR_H
 
 #include <string>
-#include <variant>
 #include <vector>
 
 #include "Token.h"
+#include "Value.h"
 
 
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
-
 namespace lox {
 
 namespace expr {
@@ -23,20 +21,55 @@ template <class T>
 class Visitor;
 
 
+// which class a node is, so accept can hand it to the matching visit
+// method without a virtual call per visitor type
+
+enum class Kind {
+  NONE,
+  ASSIGN,
+  BINARY,
+  CALL,
+  GET,
+  GROUPING,
+  LITERAL,
+  LOGICAL,
+  SET,
+  SUPER,
+  THIS,
+  UNARY,
+  VARIABLE,
+};
+
+
 // expr class
 
 class Expr {
+ private:
+  // dense node ID handed out by the parser; -1 marks an absent node
+  int id = -1;
+  Kind kind = Kind::NONE;
+  // the node the script owns; the copies a parent node keeps of its
+  // children refer back to it
+  const Expr* node = nullptr;
+
+ protected:
+  Expr(const Kind& kind) : kind(kind) {}
+
  public:
+  Expr() = default;
+  Expr(const Expr&) = default;
+  virtual ~Expr() = default;
+
   friend bool operator==(const Expr& _x, const Expr& _y) {
-    return _x == _y;
+    return _x.id == _y.id;
   }
 
-  bool operator==(const std::nullptr_t& _y) const {
-    return *this == _y;
+  bool operator==(const std::nullptr_t&) const {
+    return id < 0;
   }
 
   friend bool operator!=(const Expr& _x, const Expr& _y) {
-    return _x != _y;
+    return !(_x == _y);
   }
 
   bool operator!=(const std::nullptr_t& _y) const {
@@ -44,34 +77,53 @@ class Expr {
   }
 
   Expr& operator=(const std::nullptr_t&) {
+    id = -1;
+    kind = Kind::NONE;
+    node = nullptr;
     return *this;
   }
 
-  Expr& operator=(const Expr&) {
+  Expr& operator=(const Expr& other) {
+    id = other.id;
+    kind = other.kind;
+    node = other.node;
     return *this;
   }
 
+  const int& getId() const {
+    return id;
+  }
+
+  // called on the node the script keeps, once it is in place
+  void setId(const int& _id) {
+    id = _id;
+    node = this;
+  }
+
+  const Kind& getKind() const {
+    return kind;
+  }
+
+  // the node this refers to, as the class it was made as
+  const Expr& getNode() const {
+    return *node;
+  }
+
   template <class T>
-  const T accept(const Visitor<T>& visitor) const;
+  const T accept(Visitor<T>& visitor) const;
 };
 
 
-// TODO: template specialization
-// https://en.cppreference.com/w/cpp/language/template_specialization
-
 // assign expr
 
 class Assign : public Expr {
  private:
   const Token& name;
-  const Expr& value;
+  Expr value;
 
  public:
   Assign(const Token& name, const Expr& value);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getName() const {
     return name;
   }
@@ -86,16 +138,13 @@ class Assign : public Expr {
 
 class Binary : public Expr {
  private:
-  const Expr& left;
+  Expr left;
   const Token& op;
-  const Expr& right;
+  Expr right;
 
  public:
   Binary(const Expr& left, const Token& op, const Expr& right);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Expr& getLeft() const {
     return left;
   }
@@ -114,9 +163,9 @@ class Binary : public Expr {
 
 class Call : public Expr {
  private:
-  const Expr& callee;
+  Expr callee;
   const Token& paren;
-  const std::vector<Expr>& arguments;
+  std::vector<Expr> arguments;
 
  public:
   Call(
@@ -124,9 +173,6 @@ class Call : public Expr {
       const Token& paren,
       const std::vector<Expr>& arguments);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Expr& getCallee() const {
     return callee;
   }
@@ -145,15 +191,12 @@ class Call : public Expr {
 
 class Get : public Expr {
  private:
-  const Expr& object;
+  Expr object;
   const Token& name;
 
  public:
   Get(const Expr& object, const Token& name);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Expr& getObject() const {
     return object;
   }
@@ -168,14 +211,11 @@ class Get : public Expr {
 
 class Grouping : public Expr {
  private:
-  const Expr& expression;
+  Expr expression;
 
  public:
   Grouping(const Expr& expression);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Expr& getExpression() const {
     return expression;
   }
@@ -186,17 +226,23 @@ class Grouping : public Expr {
 
 class Literal : public Expr {
  private:
-  const std::string& value;
+  // nil, a boolean or a number
+  Value value;
+  // a string literal's characters, which stay in the script's tokens until
+  // the resolver makes a heap string of them
+  const std::string* text = nullptr;
 
  public:
-  Literal(const Object& value);
-
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
+  Literal(const Value& value);
+  Literal(const Token& string);
 
-  const std::string& getValue() const {
+  const Value& getValue() const {
     return value;
   }
+
+  const std::string* getText() const {
+    return text;
+  }
 };
 
 
@@ -204,16 +250,13 @@ class Literal : public Expr {
 
 class Logical : public Expr {
  private:
-  const Expr& left;
+  Expr left;
   const Token& op;
-  const Expr& right;
+  Expr right;
 
  public:
   Logical(const Expr& left, const Token& op, const Expr& right);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Expr& getLeft() const {
     return left;
   }
@@ -232,16 +275,13 @@ class Logical : public Expr {
 
 class Set : public Expr {
  private:
-  const Expr& object;
+  Expr object;
   const Token& name;
-  const Expr& value;
+  Expr value;
 
  public:
   Set(const Expr& object, const Token& name, const Expr& value);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Expr& getObject() const {
     return object;
   }
@@ -266,9 +306,6 @@ class Super : public Expr {
  public:
   Super(const Token& keyword, const Token& method);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getKeyword() const {
     return keyword;
   }
@@ -276,6 +313,11 @@ class Super : public Expr {
   const Token& getMethod() const {
     return method;
   }
+
+  // the receiver is looked up through the ID reserved after this node's
+  int getThisId() const {
+    return getId() + 1;
+  }
 };
 
 
@@ -288,9 +330,6 @@ class This : public Expr {
  public:
   This(const Token& keyword);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getKeyword() const {
     return keyword;
   }
@@ -302,14 +341,11 @@ class This : public Expr {
 class Unary : public Expr {
  private:
   const Token& op;
-  const Expr& right;
+  Expr right;
 
  public:
   Unary(const Token& op, const Expr& right);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getOp() const {
     return op;
   }
@@ -329,9 +365,6 @@ class Variable : public Expr {
  public:
   Variable(const Token& name);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getName() const {
     return name;
   }
@@ -343,21 +376,58 @@ class Variable : public Expr {
 template <class T>
 class Visitor : public Expr {
  public:
-  virtual T visitAssignExpr(const Assign& expr) const = 0;
-  virtual T visitBinaryExpr(const Binary& expr) const = 0;
-  virtual T visitCallExpr(const Call& expr) const = 0;
-  virtual T visitGetExpr(const Get& expr) const = 0;
-  virtual T visitGroupingExpr(const Grouping& expr) const = 0;
-  virtual T visitLiteralExpr(const Literal& expr) const = 0;
-  virtual T visitLogicalExpr(const Logical& expr) const = 0;
-  virtual T visitSetExpr(const Set& expr) const = 0;
-  virtual T visitSuperExpr(const Super& expr) const = 0;
-  virtual T visitThisExpr(const This& expr) const = 0;
-  virtual T visitUnaryExpr(const Unary& expr) const = 0;
-  virtual T visitVariableExpr(const Variable& expr) const = 0;
+  virtual T visitAssignExpr(const Assign& expr) = 0;
+  virtual T visitBinaryExpr(const Binary& expr) = 0;
+  virtual T visitCallExpr(const Call& expr) = 0;
+  virtual T visitGetExpr(const Get& expr) = 0;
+  virtual T visitGroupingExpr(const Grouping& expr) = 0;
+  virtual T visitLiteralExpr(const Literal& expr) = 0;
+  virtual T visitLogicalExpr(const Logical& expr) = 0;
+  virtual T visitSetExpr(const Set& expr) = 0;
+  virtual T visitSuperExpr(const Super& expr) = 0;
+  virtual T visitThisExpr(const This& expr) = 0;
+  virtual T visitUnaryExpr(const Unary& expr) = 0;
+  virtual T visitVariableExpr(const Variable& expr) = 0;
 };
 
 
+// dispatch
+
+template <class T>
+const T Expr::accept(Visitor<T>& visitor) const {
+  switch (kind) {
+    case Kind::ASSIGN:
+      return visitor.visitAssignExpr(static_cast<const Assign&>(*node));
+    case Kind::BINARY:
+      return visitor.visitBinaryExpr(static_cast<const Binary&>(*node));
+    case Kind::CALL:
+      return visitor.visitCallExpr(static_cast<const Call&>(*node));
+    case Kind::GET:
+      return visitor.visitGetExpr(static_cast<const Get&>(*node));
+    case Kind::GROUPING:
+      return visitor.visitGroupingExpr(static_cast<const Grouping&>(*node));
+    case Kind::LITERAL:
+      return visitor.visitLiteralExpr(static_cast<const Literal&>(*node));
+    case Kind::LOGICAL:
+      return visitor.visitLogicalExpr(static_cast<const Logical&>(*node));
+    case Kind::SET:
+      return visitor.visitSetExpr(static_cast<const Set&>(*node));
+    case Kind::SUPER:
+      return visitor.visitSuperExpr(static_cast<const Super&>(*node));
+    case Kind::THIS:
+      return visitor.visitThisExpr(static_cast<const This&>(*node));
+    case Kind::UNARY:
+      return visitor.visitUnaryExpr(static_cast<const Unary&>(*node));
+    case Kind::VARIABLE:
+      return visitor.visitVariableExpr(static_cast<const Variable&>(*node));
+    default:
+      break;
+  }
+
+  return T();
+}
+
+
 }  // namespace expr
 
 }  // namespace lox
@@ -0,0 +1,390 @@
+#include <vector>
+
+#include "Expr.h"
+#include "Fuser.h"
+#include "Interpreter.h"
+#include "Stmt.h"
+#include "TokenType.h"
+#include "Value.h"
+
+
+namespace lox {
+
+Fuser::Fuser(lox::Interpreter& interpreter) : interpreter(interpreter) {}
+
+
+void Fuser::fuse(const std::vector<lox::stmt::Stmt>& statements) {
+  for (const lox::stmt::Stmt& statement : statements) {
+    Fuser::fuse(statement);
+  }
+}
+
+
+void Fuser::fuse(const lox::stmt::Stmt& _stmt) {
+  _stmt.accept(*this);
+}
+
+
+void Fuser::fuse(const lox::expr::Expr& _expr) {
+  _expr.accept(*this);
+}
+
+
+// matching helpers
+//
+// Only names the resolver kept in a stack slot take part, since a slot is
+// read without going through a cell or the global table.
+
+bool Fuser::isLocal(const int& node) const {
+  return reads[node] &&
+         interpreter.getBinding(node).kind == BindingKind::STACK;
+}
+
+
+bool Fuser::isConstant(const int& node) const {
+  return literals[node] && interpreter.getConstant(node).isNumber();
+}
+
+
+bool Fuser::sameVariable(const int& a, const int& b) const {
+  const Binding& x = interpreter.getBinding(a);
+  const Binding& y = interpreter.getBinding(b);
+  return x.kind == y.kind && x.index == y.index;
+}
+
+
+bool Fuser::operand(const lox::expr::Expr& _expr, Operand& result) const {
+  if (Fuser::isLocal(_expr.getId())) {
+    result.slot = interpreter.getBinding(_expr.getId()).index;
+    return true;
+  }
+
+  if (Fuser::isConstant(_expr.getId())) {
+    result.constant = interpreter.getConstant(_expr.getId()).asNumber();
+    return true;
+  }
+
+  return false;
+}
+
+
+// a comparison of two locals, or of a local and a number, that a branch can
+// test without making a Value of the result
+
+Fusion Fuser::compareBranch(const lox::expr::Expr& condition) const {
+  const lox::expr::Binary* binary = binaries[condition.getId()];
+  if (binary == nullptr) {
+    return Fusion{};
+  }
+
+  switch (binary->getOp().tokentype()) {
+    case TokenType::GREATER:
+    case TokenType::GREATER_EQUAL:
+    case TokenType::LESS:
+    case TokenType::LESS_EQUAL:
+      break;
+
+    default:
+      return Fusion{};
+  }
+
+  Fusion fusion{Pattern::COMPARE_BRANCH, binary};
+  if (!Fuser::operand(binary->getLeft(), fusion.left) ||
+      !Fuser::operand(binary->getRight(), fusion.right) ||
+      (fusion.left.slot == -1 && fusion.right.slot == -1)) {
+    return Fusion{};
+  }
+
+  return fusion;
+}
+
+
+// the loop a for statement desugars to when it steps a stack local by a
+// constant towards a bound that is a number or another local:
+//
+//   while (i < n) { body; i = i + 1; }
+
+Fusion Fuser::countedLoop(const lox::stmt::While& loop) const {
+  Fusion fusion = Fuser::compareBranch(loop.getCondition());
+  const lox::stmt::Block* block = blocks[loop.getBody().getId()];
+
+  if (fusion.pattern == Pattern::NONE || fusion.left.slot == -1 ||
+      fusion.right.slot == fusion.left.slot || block == nullptr ||
+      block->getStatements().size() != 2) {
+    return Fusion{};
+  }
+
+  const lox::stmt::Stmt& increment = block->getStatements().back();
+  const lox::expr::Expr* update = expressions[increment.getId()];
+  if (update == nullptr) {
+    return Fusion{};
+  }
+
+  const Fusion& step = interpreter.getFusion(update->getId());
+  if (step.pattern != Pattern::INCREMENT_LOCAL ||
+      step.left.slot != fusion.left.slot) {
+    return Fusion{};
+  }
+
+  fusion.pattern = Pattern::COUNTED_LOOP;
+  fusion.body = &block->getStatements().front();
+  fusion.increment = &increment;
+  fusion.step = step.right.constant;
+  return fusion;
+}
+
+
+// block stmt
+
+void Fuser::visitBlockStmt(const lox::stmt::Block& _stmt) {
+  Fuser::fuse(_stmt.getStatements());
+  blocks.set(_stmt.getId(), &_stmt);
+}
+
+
+// class stmt
+
+void Fuser::visitClassStmt(const lox::stmt::Class& _stmt) {
+  for (const lox::stmt::Function& method : _stmt.getMethods()) {
+    Fuser::visitFunctionStmt(method);
+  }
+}
+
+
+// expression stmt
+
+void Fuser::visitExpressionStmt(const lox::stmt::Expression& _stmt) {
+  Fuser::fuse(_stmt.getExpression());
+  expressions.set(_stmt.getId(), &_stmt.getExpression());
+}
+
+
+// function stmt
+
+void Fuser::visitFunctionStmt(const lox::stmt::Function& _stmt) {
+  Fuser::fuse(_stmt.getBody());
+}
+
+
+// if stmt
+
+void Fuser::visitIfStmt(const lox::stmt::If& _stmt) {
+  Fuser::fuse(_stmt.getCondition());
+  Fuser::fuse(_stmt.getThenBranch());
+
+  if (_stmt.getElseBranch() != nullptr) {
+    Fuser::fuse(_stmt.getElseBranch());
+  }
+
+  Fusion fusion = Fuser::compareBranch(_stmt.getCondition());
+  if (fusion.pattern != Pattern::NONE) {
+    interpreter.resolveFusion(_stmt.getId(), fusion);
+  }
+}
+
+
+// print stmt
+
+void Fuser::visitPrintStmt(const lox::stmt::Print& _stmt) {
+  Fuser::fuse(_stmt.getExpression());
+}
+
+
+// return stmt
+
+void Fuser::visitReturnStmt(const lox::stmt::Return& _stmt) {
+  if (_stmt.getValue() != nullptr) {
+    Fuser::fuse(_stmt.getValue());
+  }
+}
+
+
+// var stmt
+//
+// var t = a; with both in stack slots is a single slot-to-slot copy.
+
+void Fuser::visitVarStmt(const lox::stmt::Var& _stmt) {
+  if (_stmt.getInitializer() == nullptr) {
+    return;
+  }
+
+  Fuser::fuse(_stmt.getInitializer());
+
+  int source = _stmt.getInitializer().getId();
+  if (interpreter.getBinding(_stmt.getId()).kind == BindingKind::STACK &&
+      Fuser::isLocal(source)) {
+    Fusion fusion{Pattern::COPY_LOCAL};
+    fusion.left.slot = interpreter.getBinding(source).index;
+    fusion.right.slot = interpreter.getBinding(_stmt.getId()).index;
+    interpreter.resolveFusion(_stmt.getId(), fusion);
+  }
+}
+
+
+// while stmt
+
+void Fuser::visitWhileStmt(const lox::stmt::While& _stmt) {
+  Fuser::fuse(_stmt.getCondition());
+  Fuser::fuse(_stmt.getBody());
+
+  Fusion fusion = Fuser::countedLoop(_stmt);
+  if (fusion.pattern == Pattern::NONE) {
+    fusion = Fuser::compareBranch(_stmt.getCondition());
+  }
+
+  if (fusion.pattern != Pattern::NONE) {
+    interpreter.resolveFusion(_stmt.getId(), fusion);
+  }
+}
+
+
+// assign expr
+//
+// i = i + 1, or i = 1 + i, with i in a stack slot adds the constant in place.
+
+void Fuser::visitAssignExpr(const lox::expr::Assign& _expr) {
+  Fuser::fuse(_expr.getValue());
+
+  const lox::expr::Binary* binary = binaries[_expr.getValue().getId()];
+  if (binary == nullptr || binary->getOp().tokentype() != TokenType::PLUS ||
+      interpreter.getBinding(_expr.getId()).kind != BindingKind::STACK) {
+    return;
+  }
+
+  int left = binary->getLeft().getId();
+  int right = binary->getRight().getId();
+  Fusion fusion{Pattern::INCREMENT_LOCAL, binary};
+  fusion.left.slot = interpreter.getBinding(_expr.getId()).index;
+
+  if (Fuser::isLocal(left) && Fuser::sameVariable(left, _expr.getId()) &&
+      Fuser::isConstant(right)) {
+    fusion.right.constant = interpreter.getConstant(right).asNumber();
+  } else if (
+      Fuser::isLocal(right) && Fuser::sameVariable(right, _expr.getId()) &&
+      Fuser::isConstant(left)) {
+    fusion.right.constant = interpreter.getConstant(left).asNumber();
+  } else {
+    return;
+  }
+
+  interpreter.resolveFusion(_expr.getId(), fusion);
+}
+
+
+// binary expr
+
+void Fuser::visitBinaryExpr(const lox::expr::Binary& _expr) {
+  Fuser::fuse(_expr.getLeft());
+  Fuser::fuse(_expr.getRight());
+  binaries.set(_expr.getId(), &_expr);
+}
+
+
+// call expr
+
+void Fuser::visitCallExpr(const lox::expr::Call& _expr) {
+  Fuser::fuse(_expr.getCallee());
+
+  for (const lox::expr::Expr& argument : _expr.getArguments()) {
+    Fuser::fuse(argument);
+  }
+}
+
+
+// get expr
+
+void Fuser::visitGetExpr(const lox::expr::Get& _expr) {
+  Fuser::fuse(_expr.getObject());
+  gets.set(_expr.getId(), &_expr);
+}
+
+
+// grouping expr
+
+void Fuser::visitGroupingExpr(const lox::expr::Grouping& _expr) {
+  Fuser::fuse(_expr.getExpression());
+}
+
+
+// literal expr
+
+void Fuser::visitLiteralExpr(const lox::expr::Literal& _expr) {
+  literals.set(_expr.getId(), true);
+}
+
+
+// logical expr
+
+void Fuser::visitLogicalExpr(const lox::expr::Logical& _expr) {
+  Fuser::fuse(_expr.getLeft());
+  Fuser::fuse(_expr.getRight());
+}
+
+
+// set expr
+//
+// x.y = x.y op z reads x once and goes through the field's caches once each
+// way. The object is evaluated before the value either way, so x cannot
+// change in between.
+
+void Fuser::visitSetExpr(const lox::expr::Set& _expr) {
+  Fuser::fuse(_expr.getObject());
+  Fuser::fuse(_expr.getValue());
+
+  const lox::expr::Binary* binary = binaries[_expr.getValue().getId()];
+  if (binary == nullptr || !reads[_expr.getObject().getId()]) {
+    return;
+  }
+
+  switch (binary->getOp().tokentype()) {
+    case TokenType::PLUS:
+    case TokenType::MINUS:
+    case TokenType::STAR:
+    case TokenType::SLASH:
+      break;
+
+    default:
+      return;
+  }
+
+  const lox::expr::Get* get = gets[binary->getLeft().getId()];
+  if (get == nullptr || !reads[get->getObject().getId()] ||
+      get->getName().getLexeme() != _expr.getName().getLexeme() ||
+      !Fuser::sameVariable(
+          get->getObject().getId(), _expr.getObject().getId())) {
+    return;
+  }
+
+  Fusion fusion{Pattern::FIELD_UPDATE, binary, get};
+  interpreter.resolveFusion(_expr.getId(), fusion);
+}
+
+
+// super expr
+
+void Fuser::visitSuperExpr(const lox::expr::Super& _expr) {
+  return;
+}
+
+
+// this expr
+
+void Fuser::visitThisExpr(const lox::expr::This& _expr) {
+  reads.set(_expr.getId(), true);
+}
+
+
+// unary expr
+
+void Fuser::visitUnaryExpr(const lox::expr::Unary& _expr) {
+  Fuser::fuse(_expr.getRight());
+}
+
+
+// variable expr
+
+void Fuser::visitVariableExpr(const lox::expr::Variable& _expr) {
+  reads.set(_expr.getId(), true);
+}
+
+}  // namespace lox
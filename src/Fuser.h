@@ -0,0 +1,73 @@
+#ifndef FUSER_H
+#define FUSER_H
+
+#include <vector>
+
+#include "Expr.h"
+#include "Interpreter.h"
+#include "SideTable.h"
+#include "Stmt.h"
+
+
+namespace lox {
+
+// Runs after the resolver and looks for the node groups hot loops are made
+// of: a local incremented by a constant, a branch on a comparison of locals,
+// a field updated from its own value and a local copied into a new one.
+// Each group found is recorded on its root node, and the closure compiler
+// turns it into a single step instead of one per node. A for loop that
+// counts a local towards a bound runs with the counter held natively.
+
+class Fuser : public lox::expr::Visitor<void>,
+              public lox::stmt::Visitor<void> {
+ private:
+  lox::Interpreter& interpreter;
+  // what the nodes visited so far are, for the parents to match on
+  SideTable<bool> reads;
+  SideTable<bool> literals;
+  SideTable<const lox::expr::Binary*> binaries;
+  SideTable<const lox::expr::Get*> gets;
+  SideTable<const lox::stmt::Block*> blocks;
+  SideTable<const lox::expr::Expr*> expressions;
+
+  bool isLocal(const int& node) const;
+  bool isConstant(const int& node) const;
+  bool sameVariable(const int& a, const int& b) const;
+  bool operand(const lox::expr::Expr& _expr, Operand& result) const;
+
+ public:
+  Fuser(lox::Interpreter& interpreter);
+  void fuse(const std::vector<lox::stmt::Stmt>& statements);
+
+  void visitBlockStmt(const lox::stmt::Block& _stmt);
+  void visitClassStmt(const lox::stmt::Class& _stmt);
+  void visitExpressionStmt(const lox::stmt::Expression& _stmt);
+  void visitFunctionStmt(const lox::stmt::Function& _stmt);
+  void visitIfStmt(const lox::stmt::If& _stmt);
+  void visitPrintStmt(const lox::stmt::Print& _stmt);
+  void visitReturnStmt(const lox::stmt::Return& _stmt);
+  void visitVarStmt(const lox::stmt::Var& _stmt);
+  void visitWhileStmt(const lox::stmt::While& _stmt);
+
+  void visitAssignExpr(const lox::expr::Assign& _expr);
+  void visitBinaryExpr(const lox::expr::Binary& _expr);
+  void visitCallExpr(const lox::expr::Call& _expr);
+  void visitGetExpr(const lox::expr::Get& _expr);
+  void visitGroupingExpr(const lox::expr::Grouping& _expr);
+  void visitLiteralExpr(const lox::expr::Literal& _expr);
+  void visitLogicalExpr(const lox::expr::Logical& _expr);
+  void visitSetExpr(const lox::expr::Set& _expr);
+  void visitSuperExpr(const lox::expr::Super& _expr);
+  void visitThisExpr(const lox::expr::This& _expr);
+  void visitUnaryExpr(const lox::expr::Unary& _expr);
+  void visitVariableExpr(const lox::expr::Variable& _expr);
+
+  void fuse(const lox::stmt::Stmt& _stmt);
+  void fuse(const lox::expr::Expr& _expr);
+  Fusion compareBranch(const lox::expr::Expr& condition) const;
+  Fusion countedLoop(const lox::stmt::While& loop) const;
+};
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,78 @@
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "GlobalTable.h"
+#include "RuntimeError.h"
+#include "Token.h"
+#include "Value.h"
+
+
+namespace lox {
+
+
+int GlobalTable::slot(const std::string& name) {
+  auto it = slots.find(name);
+  if (it != slots.end()) {
+    return it->second;
+  }
+
+  int slot = names.size();
+
+  slots[name] = slot;
+  names.push_back(name);
+  values.push_back(nullptr);
+  defined.push_back(false);
+
+  return slot;
+}
+
+
+Value GlobalTable::get(const int& slot, const Token& name) const {
+  if (defined[slot]) {
+    return values[slot];
+  }
+
+  throw RuntimeError(name, "Undefined variable '" + name.getLexeme() + "'.");
+}
+
+
+void GlobalTable::assign(
+    const int& slot,
+    const Token& name,
+    const Value& value) {
+  if (defined[slot]) {
+    values[slot] = value;
+    return;
+  }
+
+  throw RuntimeError(name, "Undefined variable '" + name.getLexeme() + "'.");
+}
+
+
+void GlobalTable::define(const int& slot, const Value& value) {
+  values[slot] = value;
+  defined[slot] = true;
+}
+
+
+// every global value is a collector root
+
+void GlobalTable::mark(Heap& heap) const {
+  for (const Value& value : values) {
+    heap.mark(value);
+  }
+}
+
+
+const std::string& GlobalTable::getName(const int& slot) const {
+  return names[slot];
+}
+
+
+std::size_t GlobalTable::size() const {
+  return names.size();
+}
+
+}  // namespace lox
@@ -0,0 +1,44 @@
+#ifndef GLOBALTABLE_H
+#define GLOBALTABLE_H
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Heap.h"
+#include "RuntimeError.h"
+#include "Token.h"
+#include "Value.h"
+
+
+namespace lox {
+
+// Global variables, addressed by a slot that a name receives the first time
+// the resolver sees it. A slot can be handed out long before the global is
+// defined, so reads and writes check that the definition has happened.
+
+class GlobalTable {
+ private:
+  std::unordered_map<std::string, int> slots;
+  std::vector<std::string> names;
+  std::vector<Value> values;
+  std::vector<bool> defined;
+
+ public:
+  int slot(const std::string& name);
+
+  Value get(const int& slot, const Token& name) const;
+  void assign(const int& slot, const Token& name, const Value& value);
+  void define(const int& slot, const Value& value);
+
+  void mark(Heap& heap) const;
+
+  const std::string& getName(const int& slot) const;
+  std::size_t size() const;
+};
+
+
+}  // namespace lox
+
+#endif
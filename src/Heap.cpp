@@ -0,0 +1,431 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <ostream>
+
+#include "Heap.h"
+#include "LoxObject.h"
+#include "Upvalue.h"
+#include "Value.h"
+
+
+namespace lox {
+
+namespace {
+
+constexpr std::size_t ALIGNMENT = alignof(std::max_align_t);
+
+
+std::size_t align(const std::size_t& size) {
+  return (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+}
+
+
+// upper bounds of the pause histogram buckets, in microseconds
+constexpr std::array<long, 7> PAUSE_BOUNDS = {50, 100, 250, 500, 1000, 2500, 10000};
+
+}  // namespace
+
+
+Heap::~Heap() {
+  for (Chunk* chunk : nursery) {
+    chunk->open = false;
+  }
+
+  while (young != nullptr) {
+    LoxObject* next = young->next;
+    Heap::destroy(young);
+    young = next;
+  }
+
+  while (old != nullptr) {
+    LoxObject* next = old->next;
+    Heap::destroy(old);
+    old = next;
+  }
+
+  for (Chunk* chunk : freeChunks) {
+    std::free(chunk);
+  }
+}
+
+
+// chunks
+//
+// Chunks are aligned to their size, so the chunk an object lives in is found
+// by masking its address.
+
+void* Heap::reserve(const std::size_t& size) {
+  std::size_t bytes = align(size);
+
+  if (youngBytes + bytes > nurserySize) {
+    Heap::collectYoung();
+  }
+
+  if (current == nullptr || current->used + bytes > CHUNK_SIZE) {
+    current = Heap::newChunk();
+    nursery.push_back(current);
+  }
+
+  void* memory = reinterpret_cast<std::byte*>(current) + current->used;
+  current->used += bytes;
+  current->live++;
+  youngBytes += bytes;
+
+  return memory;
+}
+
+
+Heap::Chunk* Heap::newChunk() {
+  Chunk* chunk;
+
+  if (!freeChunks.empty()) {
+    chunk = freeChunks.back();
+    freeChunks.pop_back();
+  } else {
+    chunk = static_cast<Chunk*>(std::aligned_alloc(CHUNK_SIZE, CHUNK_SIZE));
+    if (chunk == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+
+  chunk->used = align(sizeof(Chunk));
+  chunk->live = 0;
+  chunk->open = true;
+  return chunk;
+}
+
+
+// keep about one nursery's worth of empty chunks for reuse
+
+void Heap::releaseChunk(Chunk* chunk) {
+  if (freeChunks.size() * CHUNK_SIZE < nurserySize) {
+    freeChunks.push_back(chunk);
+  } else {
+    std::free(chunk);
+  }
+}
+
+
+Heap::Chunk* Heap::chunkOf(const LoxObject* object) {
+  return reinterpret_cast<Chunk*>(
+      reinterpret_cast<std::uintptr_t>(object) & ~(CHUNK_SIZE - 1));
+}
+
+
+void Heap::destroy(LoxObject* object) {
+  Chunk* chunk = Heap::chunkOf(object);
+
+  stats.objectsFreed++;
+  stats.bytesFreed += object->byteSize();
+  object->~LoxObject();
+
+  chunk->live--;
+  if (chunk->live == 0 && !chunk->open) {
+    Heap::releaseChunk(chunk);
+  }
+}
+
+
+// minor collection
+
+void Heap::collectYoung() {
+  auto start = std::chrono::steady_clock::now();
+  collectingYoung = true;
+
+  for (RootSource* source : roots) {
+    source->markRoots(*this);
+  }
+
+  for (const Value& value : temporaries) {
+    Heap::mark(value);
+  }
+
+  Heap::markRemembered();
+  Heap::traceReferences();
+  Heap::sweepYoung();
+  Heap::closeNursery();
+
+  collectingYoung = false;
+  Heap::recordPause(start, true);
+
+  if (oldBytes > nextCollection) {
+    Heap::collect();
+  }
+}
+
+
+// full collection
+
+void Heap::collect() {
+  auto start = std::chrono::steady_clock::now();
+
+  // a full trace finds every old-to-young reference on its own
+  for (LoxObject* object : rememberedObjects) {
+    object->remembered = false;
+  }
+  for (const auto& cell : rememberedCells) {
+    cell->remembered = false;
+  }
+  rememberedObjects.clear();
+  rememberedCells.clear();
+
+  for (RootSource* source : roots) {
+    source->markRoots(*this);
+  }
+
+  for (const Value& value : temporaries) {
+    Heap::mark(value);
+  }
+
+  Heap::traceReferences();
+  Heap::sweepOld();
+  Heap::sweepYoung();
+  Heap::closeNursery();
+
+  nextCollection = std::max(
+      minimumThreshold, static_cast<std::size_t>(oldBytes * growthFactor));
+
+  Heap::recordPause(start, false);
+}
+
+
+// mark
+
+void Heap::mark(const Value& value) {
+  if (value.isObject()) {
+    Heap::mark(value.asObject());
+  }
+}
+
+
+void Heap::mark(const LoxObject* object) {
+  if (object == nullptr || object->marked) {
+    return;
+  }
+
+  // a minor collection treats the whole old generation as live
+  if (collectingYoung && object->old) {
+    return;
+  }
+
+  // marking only flips a bit; the collector owns the objects it marks
+  const_cast<LoxObject*>(object)->marked = true;
+  gray.push_back(const_cast<LoxObject*>(object));
+}
+
+
+// old objects and cells written since the last collection may hold the only
+// reference to a young object
+
+void Heap::markRemembered() {
+  for (LoxObject* object : rememberedObjects) {
+    object->remembered = false;
+    object->trace(*this);
+  }
+
+  for (const auto& cell : rememberedCells) {
+    cell->remembered = false;
+    Heap::mark(cell->get());
+  }
+
+  rememberedObjects.clear();
+  rememberedCells.clear();
+}
+
+
+// trace references
+//
+// Gray objects are kept on an explicit worklist rather than traced
+// recursively, so long chains of objects cannot overflow the native stack.
+
+void Heap::traceReferences() {
+  while (!gray.empty()) {
+    LoxObject* object = gray.back();
+    gray.pop_back();
+    object->trace(*this);
+  }
+}
+
+
+// sweep
+//
+// Young survivors are promoted where they stand; the chunk they occupy stays
+// allocated until its last object dies.
+
+void Heap::sweepYoung() {
+  LoxObject* object = young;
+
+  while (object != nullptr) {
+    LoxObject* next = object->next;
+
+    if (object->marked) {
+      object->marked = false;
+      object->old = true;
+      object->next = old;
+      old = object;
+
+      oldBytes += object->byteSize();
+      oldCount++;
+      stats.objectsPromoted++;
+    } else {
+      Heap::destroy(object);
+    }
+
+    object = next;
+  }
+
+  young = nullptr;
+  youngBytes = 0;
+  youngCount = 0;
+}
+
+
+void Heap::sweepOld() {
+  LoxObject* previous = nullptr;
+  LoxObject* object = old;
+  oldBytes = 0;
+
+  while (object != nullptr) {
+    if (object->marked) {
+      object->marked = false;
+      oldBytes += object->byteSize();
+      previous = object;
+      object = object->next;
+      continue;
+    }
+
+    LoxObject* unreached = object;
+    object = object->next;
+
+    if (previous != nullptr) {
+      previous->next = object;
+    } else {
+      old = object;
+    }
+
+    oldCount--;
+    Heap::destroy(unreached);
+  }
+}
+
+
+// start the next nursery in fresh chunks; the ones just swept either hold
+// promoted objects or go back to the free list
+
+void Heap::closeNursery() {
+  for (Chunk* chunk : nursery) {
+    chunk->open = false;
+
+    if (chunk->live == 0) {
+      Heap::releaseChunk(chunk);
+    }
+  }
+
+  nursery.clear();
+  current = nullptr;
+}
+
+
+void Heap::recordPause(
+    const std::chrono::steady_clock::time_point& start,
+    const bool& minor) {
+  auto pause = std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now() - start);
+  long micros =
+      std::chrono::duration_cast<std::chrono::microseconds>(pause).count();
+
+  std::size_t bucket = 0;
+  while (bucket < PAUSE_BOUNDS.size() && micros >= PAUSE_BOUNDS[bucket]) {
+    bucket++;
+  }
+
+  stats.totalPause += pause;
+
+  if (minor) {
+    stats.minorCollections++;
+    stats.maxMinorPause = std::max(stats.maxMinorPause, pause);
+    stats.minorPauses[bucket]++;
+  } else {
+    stats.majorCollections++;
+    stats.maxMajorPause = std::max(stats.maxMajorPause, pause);
+    stats.majorPauses[bucket]++;
+  }
+}
+
+
+// configuration
+
+void Heap::addRoots(RootSource* source) {
+  roots.push_back(source);
+}
+
+
+void Heap::removeRoots(RootSource* source) {
+  roots.erase(std::remove(roots.begin(), roots.end(), source), roots.end());
+}
+
+
+void Heap::setGrowthFactor(const double& factor) {
+  growthFactor = std::max(1.0, factor);
+}
+
+
+void Heap::setMinimumThreshold(const std::size_t& bytes) {
+  minimumThreshold = bytes;
+  nextCollection = std::max(oldBytes, bytes);
+}
+
+
+void Heap::setNurserySize(const std::size_t& bytes) {
+  nurserySize = std::max(bytes, CHUNK_SIZE);
+}
+
+
+// statistics
+
+const GcStats& Heap::getStats() const {
+  return stats;
+}
+
+
+std::size_t Heap::liveBytes() const {
+  return oldBytes + youngBytes;
+}
+
+
+void Heap::report(std::ostream& out) const {
+  auto millis = [](const std::chrono::nanoseconds& time) {
+    return std::chrono::duration<double, std::milli>(time).count();
+  };
+
+  out << "[gc] collections: " << stats.minorCollections << " minor, "
+      << stats.majorCollections << " major\n";
+  out << "[gc] pause total: " << millis(stats.totalPause)
+      << " ms, max minor: " << millis(stats.maxMinorPause)
+      << " ms, max major: " << millis(stats.maxMajorPause) << " ms\n";
+  out << "[gc] promoted: " << stats.objectsPromoted << " objects\n";
+  out << "[gc] freed: " << stats.bytesFreed << " bytes ("
+      << stats.objectsFreed << " objects)\n";
+  out << "[gc] live heap: " << Heap::liveBytes() << " bytes ("
+      << oldCount + youngCount << " objects, " << youngCount << " young)\n";
+
+  out << "[gc] pause histogram (minor / major):\n";
+  for (std::size_t i = 0; i < stats.minorPauses.size(); i++) {
+    out << "[gc]   ";
+    if (i < PAUSE_BOUNDS.size()) {
+      out << "< " << PAUSE_BOUNDS[i] << " us";
+    } else {
+      out << ">= " << PAUSE_BOUNDS.back() << " us";
+    }
+    out << ": " << stats.minorPauses[i] << " / " << stats.majorPauses[i]
+        << "\n";
+  }
+  out.flush();
+}
+
+}  // namespace lox
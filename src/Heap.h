@@ -0,0 +1,203 @@
+#ifndef HEAP_H
+#define HEAP_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+#include "LoxObject.h"
+#include "Upvalue.h"
+#include "Value.h"
+
+
+namespace lox {
+
+class Heap;
+
+
+// Whoever holds references the collector cannot see on its own. The
+// interpreter marks its globals, value stack, cells and constants; the VM
+// marks its own stack, frames and cells.
+
+class RootSource {
+ public:
+  virtual ~RootSource() = default;
+  virtual void markRoots(Heap& heap) = 0;
+};
+
+
+// pause counts per bucket; the last bucket is open-ended
+using PauseHistogram = std::array<std::size_t, 8>;
+
+
+struct GcStats {
+  std::size_t minorCollections = 0;
+  std::size_t majorCollections = 0;
+  std::size_t objectsPromoted = 0;
+  std::size_t objectsFreed = 0;
+  std::size_t bytesFreed = 0;
+  std::chrono::nanoseconds totalPause{0};
+  std::chrono::nanoseconds maxMinorPause{0};
+  std::chrono::nanoseconds maxMajorPause{0};
+  PauseHistogram minorPauses{};
+  PauseHistogram majorPauses{};
+};
+
+
+// Owner of every object the interpreter allocates, split in two
+// generations.
+//
+// New objects are bump-allocated into nursery chunks. When the nursery is
+// full, a minor collection marks only young objects reachable from the
+// roots and the remembered set; survivors are promoted in place, dead
+// objects are destroyed, and chunks left empty are reused. Objects never
+// move, so raw pointers held by native code stay valid.
+//
+// Old objects are reclaimed by a full mark-sweep that runs once the old
+// generation grows past its threshold; the threshold then becomes the live
+// old heap times the growth factor.
+//
+// Stores that may create an old-to-young reference go through a write
+// barrier, which records the old instance or the cell in the remembered set.
+
+class Heap {
+ private:
+  static constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+  struct Chunk {
+    std::size_t used;
+    std::size_t live;
+    // still part of the nursery that is being filled
+    bool open;
+  };
+
+  LoxObject* young = nullptr;
+  LoxObject* old = nullptr;
+  std::vector<RootSource*> roots;
+  std::vector<LoxObject*> gray;
+  std::vector<Value> temporaries;
+  std::vector<LoxObject*> rememberedObjects;
+  std::vector<std::shared_ptr<Upvalue>> rememberedCells;
+
+  std::vector<Chunk*> nursery;
+  std::vector<Chunk*> freeChunks;
+  Chunk* current = nullptr;
+  bool collectingYoung = false;
+
+  std::size_t nurserySize = 512 * 1024;
+  std::size_t youngBytes = 0;
+  std::size_t youngCount = 0;
+  std::size_t oldBytes = 0;
+  std::size_t oldCount = 0;
+  std::size_t minimumThreshold = 4 * 1024 * 1024;
+  std::size_t nextCollection = 4 * 1024 * 1024;
+  double growthFactor = 2.0;
+  GcStats stats;
+
+  void* reserve(const std::size_t& size);
+  Chunk* newChunk();
+  void releaseChunk(Chunk* chunk);
+  static Chunk* chunkOf(const LoxObject* object);
+  void destroy(LoxObject* object);
+
+  void markRemembered();
+  void traceReferences();
+  void sweepYoung();
+  void sweepOld();
+  void closeNursery();
+  void recordPause(
+      const std::chrono::steady_clock::time_point& start,
+      const bool& minor);
+
+  friend class TemporaryRoots;
+
+ public:
+  Heap() {}
+  Heap(const Heap&) = delete;
+  Heap& operator=(const Heap&) = delete;
+  ~Heap();
+
+  template <class T, class... Args>
+  T* allocate(Args&&... args) {
+    void* memory = Heap::reserve(sizeof(T));
+    T* object = new (memory) T(std::forward<Args>(args)...);
+
+    object->next = young;
+    young = object;
+    youngCount++;
+    return object;
+  }
+
+  void collectYoung();
+  void collect();
+  void mark(const Value& value);
+  void mark(const LoxObject* object);
+
+  // call before storing value into owner
+  void writeBarrier(LoxObject* owner, const Value& value) {
+    if (owner->old && !owner->remembered && value.isObject() &&
+        !value.asObject()->old) {
+      owner->remembered = true;
+      rememberedObjects.push_back(owner);
+    }
+  }
+
+  // call before storing value into a captured cell, which may be owned by
+  // closures of any age
+  void writeBarrier(const std::shared_ptr<Upvalue>& cell, const Value& value) {
+    if (!cell->remembered && value.isObject() && !value.asObject()->old) {
+      cell->remembered = true;
+      rememberedCells.push_back(cell);
+    }
+  }
+
+  void addRoots(RootSource* source);
+  void removeRoots(RootSource* source);
+  void setGrowthFactor(const double& factor);
+  void setMinimumThreshold(const std::size_t& bytes);
+  void setNurserySize(const std::size_t& bytes);
+
+  const GcStats& getStats() const;
+  std::size_t liveBytes() const;
+  void report(std::ostream& out) const;
+};
+
+
+// Keeps values that live only in C++ locals reachable while the code holding
+// them evaluates further expressions or allocates. Everything pushed is
+// released when the guard goes out of scope, including during unwinding.
+
+class TemporaryRoots {
+ private:
+  Heap& heap;
+  std::size_t base;
+
+ public:
+  TemporaryRoots(Heap& heap) : heap(heap), base(heap.temporaries.size()) {}
+  TemporaryRoots(const TemporaryRoots&) = delete;
+  TemporaryRoots& operator=(const TemporaryRoots&) = delete;
+
+  ~TemporaryRoots() {
+    heap.temporaries.resize(base);
+  }
+
+  void push(const Value& value) {
+    heap.temporaries.push_back(value);
+  }
+
+  // drops whatever this guard has pushed so far
+  void clear() {
+    heap.temporaries.resize(base);
+  }
+};
+
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,173 @@
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+#include "Heap.h"
+#include "InlineCache.h"
+#include "LoxClass.h"
+#include "LoxFunction.h"
+#include "LoxInstance.h"
+#include "Shape.h"
+#include "SideTable.h"
+#include "Token.h"
+#include "Value.h"
+
+
+namespace lox {
+
+const CacheEntry* PropertyCache::find(const Shape* shape) {
+  for (int i = 0; i < count; i++) {
+    if (entries[i].shape == shape->getId()) {
+      hits++;
+      return &entries[i];
+    }
+  }
+
+  misses++;
+  return nullptr;
+}
+
+
+void PropertyCache::add(const Shape* shape, Shape* next, const int& slot) {
+  if (megamorphic) {
+    return;
+  }
+
+  if (count == ENTRIES) {
+    // too many shapes pass through here for probing to pay off
+    megamorphic = true;
+    count = 0;
+    return;
+  }
+
+  entries[count++] = CacheEntry{shape->getId(), next, slot};
+}
+
+
+// methods are not cached: a miss that finds no field goes on to bind one
+
+Value PropertyCache::get(LoxInstance* instance, const Token& name, Heap& heap) {
+  const Shape* shape = instance->getShape();
+
+  if (const CacheEntry* entry = PropertyCache::find(shape)) {
+    return instance->getField(entry->slot);
+  }
+
+  int slot = shape->lookup(name.getLexeme());
+  if (slot == -1) {
+    return instance->get(name, heap);
+  }
+
+  PropertyCache::add(shape, nullptr, slot);
+  return instance->getField(slot);
+}
+
+
+void PropertyCache::set(
+    LoxInstance* instance,
+    const Token& name,
+    const Value& value,
+    Heap& heap) {
+  Shape* shape = instance->getShape();
+
+  if (const CacheEntry* entry = PropertyCache::find(shape)) {
+    if (entry->next == shape) {
+      instance->setField(entry->slot, value, heap);
+    } else {
+      instance->addField(entry->next, value, heap);
+    }
+    return;
+  }
+
+  instance->set(name, value, heap);
+
+  Shape* next = instance->getShape();
+  int slot = next == shape ? shape->lookup(name.getLexeme()) : next->size() - 1;
+  PropertyCache::add(shape, next, slot);
+}
+
+
+// the method a call on the instance runs, or nullptr when a field by that
+// name shadows it or the class has no such method
+
+LoxFunction* MethodCache::find(LoxInstance* instance, const Token& name) {
+  const Shape* shape = instance->getShape();
+
+  for (int i = 0; i < count; i++) {
+    if (entries[i].shape == shape->getId()) {
+      hits++;
+      return entries[i].method;
+    }
+  }
+
+  misses++;
+
+  if (shape->lookup(name.getLexeme()) != -1) {
+    return nullptr;
+  }
+
+  LoxFunction* method = instance->getKlass()->findMethod(name.getLexeme());
+  if (method == nullptr || megamorphic) {
+    return method;
+  }
+
+  if (count == ENTRIES) {
+    megamorphic = true;
+    count = 0;
+  } else {
+    entries[count++] = MethodEntry{shape->getId(), method};
+  }
+
+  return method;
+}
+
+
+template <class T>
+static void reportSites(
+    const std::string& kind,
+    const SideTable<T>& caches,
+    std::ostream& out) {
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+  int sites = 0;
+  int monomorphic = 0;
+  int polymorphic = 0;
+  int megamorphic = 0;
+
+  for (const CacheSite& cache : caches) {
+    if (cache.getHits() + cache.getMisses() == 0) {
+      continue;
+    }
+
+    sites++;
+    hits += cache.getHits();
+    misses += cache.getMisses();
+
+    if (cache.isMegamorphic()) {
+      megamorphic++;
+    } else if (cache.size() > 1) {
+      polymorphic++;
+    } else if (cache.size() == 1) {
+      monomorphic++;
+    }
+  }
+
+  std::uint64_t total = hits + misses;
+  out << "[ic] " << kind << " sites: " << sites << " (" << monomorphic
+      << " monomorphic, " << polymorphic << " polymorphic, " << megamorphic
+      << " megamorphic)\n";
+  out << "[ic] " << kind << " lookups: " << total << ", hits: " << hits
+      << " (" << (total == 0 ? 0.0 : 100.0 * hits / total) << "%)\n";
+}
+
+
+void reportCaches(
+    const SideTable<PropertyCache>& properties,
+    const SideTable<MethodCache>& methods,
+    std::ostream& out) {
+  reportSites("property", properties, out);
+  reportSites("invoke", methods, out);
+  out.flush();
+}
+
+}  // namespace lox
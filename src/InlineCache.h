@@ -0,0 +1,111 @@
+#ifndef INLINECACHE_H
+#define INLINECACHE_H
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+#include "Heap.h"
+#include "Shape.h"
+#include "SideTable.h"
+#include "Token.h"
+#include "Value.h"
+
+
+namespace lox {
+
+class LoxFunction;
+class LoxInstance;
+
+
+// state every cache site shares: how many entries are live, whether it gave
+// up on caching, and how often a probe hit
+
+class CacheSite {
+ protected:
+  static constexpr int ENTRIES = 4;
+
+  int count = 0;
+  bool megamorphic = false;
+  std::uint64_t hits = 0;
+  std::uint64_t misses = 0;
+
+ public:
+  int size() const {
+    return count;
+  }
+
+  bool isMegamorphic() const {
+    return megamorphic;
+  }
+
+  std::uint64_t getHits() const {
+    return hits;
+  }
+
+  std::uint64_t getMisses() const {
+    return misses;
+  }
+};
+
+
+// A per-node cache of the shapes a property access has seen. Each entry
+// remembers where the field sits for one shape, so a hit is an ID compare and
+// a slot load. A set entry also remembers the shape an instance moves to
+// when the assignment adds the field. Past ENTRIES shapes the site is
+// megamorphic and stops caching.
+
+struct CacheEntry {
+  std::uint64_t shape;
+  // the shape after a set; the same as shape when the field already exists
+  Shape* next;
+  int slot;
+};
+
+
+class PropertyCache : public CacheSite {
+ private:
+  std::array<CacheEntry, ENTRIES> entries;
+
+  const CacheEntry* find(const Shape* shape);
+  void add(const Shape* shape, Shape* next, const int& slot);
+
+ public:
+  Value get(LoxInstance* instance, const Token& name, Heap& heap);
+  void set(
+      LoxInstance* instance,
+      const Token& name,
+      const Value& value,
+      Heap& heap);
+};
+
+
+// The methods an invoke site has called, by receiver shape. A shape belongs
+// to one class and classes never change, so the shape alone decides which
+// method runs as long as no field of the same name shadows it.
+
+struct MethodEntry {
+  std::uint64_t shape;
+  LoxFunction* method;
+};
+
+
+class MethodCache : public CacheSite {
+ private:
+  std::array<MethodEntry, ENTRIES> entries;
+
+ public:
+  LoxFunction* find(LoxInstance* instance, const Token& name);
+};
+
+
+// totals over every property access and invoke site that ran
+void reportCaches(
+    const SideTable<PropertyCache>& properties,
+    const SideTable<MethodCache>& methods,
+    std::ostream& out);
+
+
+}  // namespace lox
+
+#endif
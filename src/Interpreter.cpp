@@ -1,209 +1,212 @@
-#include <iostream>
+#include <charconv>
+#include <cstddef>
+#include <memory>
 #include <string>
-#include <type_traits>
+#include <string_view>
+#include <utility>
 #include <vector>
 
-#include "Environment.h"
 #include "Expr.h"
 #include "Interpreter.h"
 #include "Lox.h"
-//#include "LoxClass.h"
-//#include "LoxFunction.h"
-//#include "LoxInstance.h"
-#include "Return.h"
+#include "LoxCallable.h"
+#include "LoxClass.h"
+#include "LoxFunction.h"
+#include "LoxInstance.h"
+#include "LoxString.h"
 #include "RuntimeError.h"
 #include "Stmt.h"
 #include "Token.h"
 #include "TokenType.h"
+#include "Value.h"
 
 
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
-
 namespace lox {
 
+// block stmt
 //
-// lox::Interpreter::Interpreter() : globals(), environment(&globals) {}
+// A block's locals live in the running frame's stack slots and cells, so
+// entering it does not set up any scope at runtime.
 
-// block stmt
-/*
-void Interpreter::visitBlockStmt(const lox::stmt::Block& _stmt) {
-  lox::Interpreter::executeBlock(
-      _stmt.getStatements(), Environment(environment));
-  return;
+lox::Completion lox::Interpreter::visitBlockStmt(
+    const lox::stmt::Block& _stmt) {
+  return lox::Interpreter::executeBlock(_stmt.getStatements());
 }
 
 
 // class stmt
 
 
-void lox::Interpreter::visitClassStmt(const lox::stmt::Class& _stmt) {
-  Object superclass = nullptr;
+lox::Completion lox::Interpreter::visitClassStmt(
+    const lox::stmt::Class& _stmt) {
+  Value superclass = nullptr;
 
   if (_stmt.getSuperclass() != nullptr) {
     superclass = lox::Interpreter::evaluate(_stmt.getSuperclass());
-    if (!(instanceof <LoxClass>(superclass))) {
-      throw new RuntimeError(
+    if (!superclass.is(ObjectType::OBJ_CLASS)) {
+      throw RuntimeError(
           _stmt.getSuperclass().getName(), "Superclass must be a class.");
     }
   }
 
-  environment.define(_stmt.getName().getLexeme(), nullptr);
-
-  if (_stmt.superclass != nullptr) {
-    environment = Environment(environment);
-    environment.define("super", superclass);
-  }
-
-  std::unordered_map<std::string, LoxFunction> methods;
+  lox::Interpreter::define(_stmt.getId(), nullptr);
 
-  for (lox::stmt::Function method : _stmt.methods) {
-    LoxFunction function = new LoxFunction(
-        method, environment, method.name.getLexeme().equals("init"));
-    methods[method.name.getLexeme()] = function;
+  if (_stmt.getSuperclass() != nullptr) {
+    lox::Interpreter::define(_stmt.getSuperId(), superclass);
   }
 
-  LoxClass klass =
-      new LoxClass(_stmt.name.getLexeme(), (LoxClass)superclass, methods);
+  TemporaryRoots roots(heap);
+  std::unordered_map<std::string, LoxFunction*> methods;
 
-  if (std::holds_alternative<Object>(superclass)) {
-    environment = environment.enclosing;
+  for (const lox::stmt::Function& method : _stmt.getMethods()) {
+    LoxFunction* function = heap.allocate<LoxFunction>(
+        functionPrototypes[method.getId()],
+        lox::Interpreter::capture(method.getId()));
+    roots.push(function);
+    methods[method.getName().getLexeme()] = function;
   }
 
-  environment.assign(_stmt.name, klass);
+  LoxClass* klass = heap.allocate<LoxClass>(
+      _stmt.getName().getLexeme(),
+      superclass.isNil() ? nullptr : superclass.as<LoxClass>(),
+      methods);
 
-  return;
-}*/
+  lox::Interpreter::store(_stmt.getId(), klass);
+  return Completion::NORMAL;
+}
 
 
 // expression stmt
 
 
-void lox::Interpreter::visitExpressionStmt(const lox::stmt::Expression& _stmt) {
+lox::Completion lox::Interpreter::visitExpressionStmt(
+    const lox::stmt::Expression& _stmt) {
   lox::Interpreter::evaluate(_stmt.getExpression());
-  return;
+  return Completion::NORMAL;
 }
 
 
 // function stmt
 
-/*
-void lox::Interpreter::visitFunctionStmt(const lox::stmt::Function& _stmt) {
-  LoxFunction function = new LoxFunction(_stmt, environment, false);
-  environment.define(_stmt.name.getLexeme(), function);
-  return;
-}
-*/
-
-// if stmt
-
 
-void lox::Interpreter::visitIfStmt(const lox::stmt::If& _stmt) {
-  Object value = lox::Interpreter::evaluate(_stmt.getCondition());
-  std::string result;
+lox::Completion lox::Interpreter::visitFunctionStmt(
+    const lox::stmt::Function& _stmt) {
+  // the name is in scope first, so a recursive function can capture itself
+  lox::Interpreter::define(_stmt.getId(), nullptr);
 
-  if (std::holds_alternative<std::nullptr_t>(value)) {
-    result = "nullptr";
+  LoxFunction* function = heap.allocate<LoxFunction>(
+      functionPrototypes[_stmt.getId()],
+      lox::Interpreter::capture(_stmt.getId()));
+  lox::Interpreter::store(_stmt.getId(), function);
+  return Completion::NORMAL;
+}
 
-  } else if (std::holds_alternative<std::string>(value)) {
-    result = std::get<std::string>(value);
 
-  } else if (std::holds_alternative<double>(value)) {
-    result = std::to_string(std::get<double>(value));
+// if stmt
 
-  } else if (std::holds_alternative<bool>(value)) {
-    result = std::get<bool>(value) ? "true" : "false";
-  }
 
-  if (lox::Interpreter::isTruthy(result)) {
-    lox::Interpreter::execute(_stmt.getThenBranch());
+lox::Completion lox::Interpreter::visitIfStmt(
+    const lox::stmt::If& _stmt) {
+  if (lox::Interpreter::isTruthy(
+          lox::Interpreter::evaluate(_stmt.getCondition()))) {
+    return lox::Interpreter::execute(_stmt.getThenBranch());
 
   } else if (_stmt.getElseBranch() != nullptr) {
-    lox::Interpreter::execute(_stmt.getElseBranch());
+    return lox::Interpreter::execute(_stmt.getElseBranch());
   }
 
-  return;
+  return Completion::NORMAL;
 }
 
 
 // print stmt
 
 
-void lox::Interpreter::visitPrintStmt(const lox::stmt::Print& _stmt) {
-  Object value = evaluate(_stmt.getExpression());
-  std::string result;
-
-  if (std::holds_alternative<std::nullptr_t>(value)) {
-    result = "nullptr";
-
-  } else if (std::holds_alternative<std::string>(value)) {
-    result = std::get<std::string>(value);
+lox::Completion lox::Interpreter::visitPrintStmt(
+    const lox::stmt::Print& _stmt) {
+  lox::Interpreter::print(
+      lox::Interpreter::evaluate(_stmt.getExpression()));
+  return Completion::NORMAL;
+}
 
-  } else if (std::holds_alternative<double>(value)) {
-    result = std::to_string(std::get<double>(value));
 
-  } else if (std::holds_alternative<bool>(value)) {
-    result = std::get<bool>(value) ? "true" : "false";
-  }
+// return stmt
 
-  std::cout << stringify(result);
-  return;
-}
 
+lox::Completion lox::Interpreter::visitReturnStmt(
+    const lox::stmt::Return& _stmt) {
+  if (const lox::expr::Call* call = tailCalls[_stmt.getId()]) {
+    TemporaryRoots roots(heap);
+    Value receiver = nullptr;
+    Value callee = lox::Interpreter::evaluateCallee(*call, receiver, roots);
 
-// return stmt
+    Arguments arguments;
+    for (const lox::expr::Expr& argument : call->getArguments()) {
+      arguments.push(lox::Interpreter::evaluate(argument));
+      roots.push(arguments.back());
+    }
 
+    return lox::Interpreter::scheduleTailCall(
+        callee, receiver, call->getParen(), arguments.values());
+  }
 
-void lox::Interpreter::visitReturnStmt(const lox::stmt::Return& _stmt) {
-  Object value = nullptr;
+  Value value = nullptr;
 
   if (_stmt.getValue() != nullptr) {
     value = lox::Interpreter::evaluate(_stmt.getValue());
   }
 
-  throw Return(value);
+  returnValue = value;
+  return Completion::RETURN;
 }
 
 
 // var stmt
 
 
-void lox::Interpreter::visitVarStmt(const lox::stmt::Var& _stmt) {
-  Object value = nullptr;
+lox::Completion lox::Interpreter::visitVarStmt(
+    const lox::stmt::Var& _stmt) {
+  Value value = nullptr;
 
   if (_stmt.getInitializer() != nullptr) {
     value = lox::Interpreter::evaluate(_stmt.getInitializer());
   }
 
-  environment.define(_stmt.getName().getLexeme(), value);
-  return;
+  lox::Interpreter::define(_stmt.getId(), value);
+  return Completion::NORMAL;
 }
 
 
 // while stmt
 
 
-void lox::Interpreter::visitWhileStmt(const lox::stmt::While& _stmt) {
-  Object value = lox::Interpreter::evaluate(_stmt.getCondition());
-  std::string result;
+lox::Completion lox::Interpreter::visitWhileStmt(
+    const lox::stmt::While& _stmt) {
+  while (lox::Interpreter::isTruthy(
+      lox::Interpreter::evaluate(_stmt.getCondition()))) {
+    Completion completion = lox::Interpreter::execute(_stmt.getBody());
+    if (completion != Completion::NORMAL) {
+      return completion;
+    }
+  }
 
-  if (std::holds_alternative<std::nullptr_t>(value)) {
-    result = "nullptr";
+  return Completion::NORMAL;
+}
 
-  } else if (std::holds_alternative<std::string>(value)) {
-    result = std::get<std::string>(value);
 
-  } else if (std::holds_alternative<double>(value)) {
-    result = std::to_string(std::get<double>(value));
+// script frame
+//
+// The top-level script's locals live at the bottom of the stacks, sized by
+// the resolver like any other frame.
 
-  } else if (std::holds_alternative<bool>(value)) {
-    result = std::get<bool>(value) ? "true" : "false";
+void lox::Interpreter::prepareScriptFrame() {
+  if (stack.size() < static_cast<std::size_t>(scriptFrame.slots)) {
+    stack.resize(scriptFrame.slots);
   }
 
-  while (lox::Interpreter::isTruthy(result)) {
-    lox::Interpreter::execute(_stmt.getBody());
+  if (cells.size() < static_cast<std::size_t>(scriptFrame.cells)) {
+    cells.resize(scriptFrame.cells);
   }
-
-  return;
 }
 
 
@@ -212,127 +215,311 @@ void lox::Interpreter::visitWhileStmt(const lox::stmt::While& _stmt) {
 
 void lox::Interpreter::interpret(
     const std::vector<lox::stmt::Stmt>& statements) {
+  lox::Interpreter::prepareScriptFrame();
+
   try {
     for (const auto& statement : statements) {
       lox::Interpreter::execute(statement);
     }
-  } catch (RuntimeError error) {
+  } catch (const RuntimeError& error) {
     Lox _lox;
     _lox.runtimeError(error);
   }
 }
 
 
-// evaluate
+// interpret a script the closure compiler converted
+
 
+void lox::Interpreter::interpret(const CompiledStmt& script) {
+  lox::Interpreter::prepareScriptFrame();
 
-// void lox::Interpreter::evaluate(const lox::stmt::Stmt& _stmt) {
-//   return _stmt.accept(*this);
-// }
+  try {
+    script();
+  } catch (const RuntimeError& error) {
+    Lox _lox;
+    _lox.runtimeError(error);
+  }
+}
 
 
 // execute
 
 
-void lox::Interpreter::execute(const lox::stmt::Stmt& _stmt) {
-  _stmt.accept(*this);
+lox::Completion lox::Interpreter::execute(const lox::stmt::Stmt& _stmt) {
+  return _stmt.accept(*this);
 }
 
 
 // execute block
 
-/*
-void executeBlock(
-    const std::vector<lox::stmt::Stmt>& statements,
-    const Environment& environment) {
-  Environment previous = environment;
 
-  try {
-    environment = environment;
+lox::Completion lox::Interpreter::executeBlock(
+    const std::vector<lox::stmt::Stmt>& statements) {
+  for (const lox::stmt::Stmt& statement : statements) {
+    Completion completion = lox::Interpreter::execute(statement);
+    if (completion != Completion::NORMAL) {
+      return completion;
+    }
+  }
+
+  return Completion::NORMAL;
+}
+
+
+// execute a function body, through its compiled form when the closure
+// compiler produced one
+
+lox::Completion lox::Interpreter::executeBody(
+    const FunctionPrototype& prototype) {
+  const CompiledStmt& body = bodies[prototype.declaration->getId()];
+
+  if (body) {
+    return body();
+  }
+
+  return lox::Interpreter::executeBlock(*prototype.body);
+}
+
+
+// frames
+//
+// A call claims a window of the value stack and of the cell stack, sized by
+// the resolver for the callee. The storage is reused by later calls, so
+// entering a function does not allocate once the stacks have grown.
+
+lox::CallFrame lox::Interpreter::pushFrame(
+    const int& node,
+    const Upvalues* upvalues) {
+  CallFrame previous = frame;
+  const FrameLayout& layout = frames[node];
+
+  frame = CallFrame{
+      static_cast<int>(stack.size()), static_cast<int>(cells.size()), upvalues};
+  stack.resize(frame.stackBase + layout.slots);
+  cells.resize(frame.cellBase + layout.cells);
+
+  return previous;
+}
+
+
+void lox::Interpreter::popFrame(const CallFrame& previous) {
+  stack.resize(frame.stackBase);
+  cellPool.release(cells, frame.cellBase);
+  frame = previous;
+}
+
+
+// define a declared name; a captured local gets a fresh cell each time its
+// declaration runs, so closures made in a loop each see their own binding
+
+void lox::Interpreter::define(const int& node, const Value& value) {
+  lox::Interpreter::define(bindings[node], value);
+}
+
+
+void lox::Interpreter::define(const Binding& binding, const Value& value) {
+  switch (binding.kind) {
+    case BindingKind::CELL:
+      cellPool.define(cells[frame.cellBase + binding.index], value);
+      break;
 
-    for (const lox::stmt::Stmt& statement : statements) {
-        lox::Interpreter::execute(statement);
+    case BindingKind::GLOBAL:
+      globals.define(binding.index, value);
+      break;
+
+    default:
+      lox::Interpreter::store(binding, value);
+  }
+}
+
+
+// overwrite the current value of a name
+
+void lox::Interpreter::store(const int& node, const Value& value) {
+  lox::Interpreter::store(bindings[node], value);
+}
+
+
+void lox::Interpreter::store(const Binding& binding, const Value& value) {
+  switch (binding.kind) {
+    case BindingKind::STACK:
+      stack[frame.stackBase + binding.index] = value;
+      break;
+
+    case BindingKind::CELL: {
+      const auto& cell = cells[frame.cellBase + binding.index];
+      heap.writeBarrier(cell, value);
+      cell->set(value);
+      break;
+    }
+
+    case BindingKind::UPVALUE: {
+      const auto& cell = (*frame.upvalues)[binding.index];
+      heap.writeBarrier(cell, value);
+      cell->set(value);
+      break;
+    }
+
+    case BindingKind::GLOBAL:
+      globals.define(binding.index, value);
+      break;
+
+    default:
+      break;
+  }
+}
+
+
+// collect the cells a closure over the given function refers to
+
+lox::Upvalues lox::Interpreter::capture(const int& node) const {
+  Upvalues upvalues;
+
+  for (const Capture& variable : captures[node]) {
+    if (variable.local) {
+      upvalues.push_back(cells[frame.cellBase + variable.index]);
+    } else {
+      upvalues.push_back((*frame.upvalues)[variable.index]);
     }
-  } catch (...) {
-    environment = previous;
   }
+
+  return upvalues;
 }
-*/
+
+
+// hand the pending return value to the call that completes, so the
+// collector does not keep it alive any longer
+
+lox::Value lox::Interpreter::takeReturnValue() {
+  Value value = returnValue;
+  returnValue = nullptr;
+  return value;
+}
+
+
+// A return in tail position hands its call back instead of making it, so the
+// calling LoxFunction can run it in the frame it is about to give up; see
+// LoxFunction::invoke. Classes are called right away, since their instance
+// has to be made first.
+
+lox::Completion lox::Interpreter::scheduleTailCall(
+    const Value& callee,
+    const Value& receiver,
+    const Token& paren,
+    std::span<const Value> arguments) {
+  if (!callee.is(ObjectType::OBJ_FUNCTION)) {
+    returnValue =
+        lox::Interpreter::callValue(callee, receiver, paren, arguments);
+    return Completion::RETURN;
+  }
+
+  lox::Interpreter::checkArity(
+      paren, *callee.as<LoxCallable>(), arguments.size());
+
+  tailCall.callee = callee;
+  tailCall.receiver = receiver;
+  tailCall.arguments.assign(arguments.begin(), arguments.end());
+  return Completion::TAIL_CALL;
+}
+
+
+// collector roots
+//
+// Values held only in C++ locals while evaluation continues are pushed as
+// TemporaryRoots by the code that holds them.
+
+void lox::Interpreter::markRoots(Heap& heap) {
+  globals.mark(heap);
+  heap.mark(returnValue);
+  heap.mark(tailCall.callee);
+  heap.mark(tailCall.receiver);
+
+  for (const Value& value : tailCall.arguments) {
+    heap.mark(value);
+  }
+
+  for (const Value& value : stack) {
+    heap.mark(value);
+  }
+
+  for (const auto& cell : cells) {
+    if (cell != nullptr) {
+      heap.mark(cell->get());
+    }
+  }
+
+  for (const Value& value : constants) {
+    heap.mark(value);
+  }
+}
+
 
 // assign expr
 
-/*
-Object lox::Interpreter::visitAssignExpr(const lox::expr::Assign& _expr) {
-  Object value = lox::Interpreter::evaluate(_expr.getValue());
-  int distance = locals[_expr];
 
-  if (distance != NULL) {
-    environment.assignAt(distance, _expr.getName(), value);
+Value lox::Interpreter::visitAssignExpr(const lox::expr::Assign& _expr) {
+  Value value = lox::Interpreter::evaluate(_expr.getValue());
+  const Binding& binding = bindings[_expr.getId()];
+
+  if (binding.kind == BindingKind::GLOBAL) {
+    globals.assign(binding.index, _expr.getName(), value);
   } else {
-    globals.assign(_expr.getName(), value);
+    lox::Interpreter::store(_expr.getId(), value);
   }
 
   return value;
 }
-*/
+
 
 // binary expr
 
-Object lox::Interpreter::visitBinaryExpr(const lox::expr::Binary& _expr) {
-  std::string left =
-      std::get<std::string>(lox::Interpreter::evaluate(_expr.getLeft()));
-  std::string right =
-      std::get<std::string>(lox::Interpreter::evaluate(_expr.getRight()));
+Value lox::Interpreter::visitBinaryExpr(const lox::expr::Binary& _expr) {
+  TemporaryRoots roots(heap);
+  Value left = lox::Interpreter::evaluate(_expr.getLeft());
+  roots.push(left);
+  Value right = lox::Interpreter::evaluate(_expr.getRight());
 
   switch (_expr.getOp().tokentype()) {
     case TokenType::MINUS:
       lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return std::stod(left) - std::stod(right);
+      return left.asNumber() - right.asNumber();
 
     case TokenType::PLUS:
-      lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      if ((std::is_same<decltype(left), double>::value) &&
-          (std::is_same<decltype(right), double>::value)) {
-        return std::stod(left) + std::stod(right);
-      }
-      if ((std::is_same<decltype(left), std::string>::value) &&
-          (std::is_same<decltype(right), std::string>::value)) {
-        return (std::string)left + (std::string)right;
-      }
-      break;
+      return lox::Interpreter::add(_expr.getOp(), left, right);
 
     case TokenType::GREATER:
       lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-
-      return std::stod(left) > std::stod(right);
+      return left.asNumber() > right.asNumber();
 
     case TokenType::GREATER_EQUAL:
       lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return std::stod(left) >= std::stod(right);
+      return left.asNumber() >= right.asNumber();
 
     case TokenType::LESS:
       lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return std::stod(left) < std::stod(right);
+      return left.asNumber() < right.asNumber();
 
     case TokenType::LESS_EQUAL:
       lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return std::stod(left) <= std::stod(right);
+      return left.asNumber() <= right.asNumber();
 
     case TokenType::BANG_EQUAL:
-      lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return !lox::Interpreter::isEqual(left, right);
-
-    case TokenType::EQUAL_EQUAL:
-      lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return !lox::Interpreter::isEqual(left, right);
+    case TokenType::EQUAL_EQUAL: {
+      bool negate = _expr.getOp().tokentype() == TokenType::BANG_EQUAL;
+      return lox::Interpreter::isEqual(left, right) != negate;
+    }
 
     case TokenType::SLASH:
       lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return std::stod(left) / std::stod(right);
+      return left.asNumber() / right.asNumber();
 
     case TokenType::STAR:
       lox::Interpreter::checkNumberOperands(_expr.getOp(), left, right);
-      return std::stod(left) * std::stod(right);
+      return left.asNumber() * right.asNumber();
+
+    default:
+      break;
   }
 
   return nullptr;
@@ -340,71 +527,144 @@ Object lox::Interpreter::visitBinaryExpr(const lox::expr::Binary& _expr) {
 
 
 // call expr
-/*
-Object lox::Interpreter::visitCallExpr(const lox::expr::Call& _expr) {
-  Object callee = lox::Interpreter::evaluate(_expr.getCallee());
 
-  std::vector<Object> arguments;
-  for (lox::expr::Expr argument : _expr.getArguments()) {
-    arguments.push_back(lox::Interpreter::evaluate(argument));
+Value lox::Interpreter::visitCallExpr(const lox::expr::Call& _expr) {
+  TemporaryRoots roots(heap);
+  Value receiver = nullptr;
+  Value callee = lox::Interpreter::evaluateCallee(_expr, receiver, roots);
+
+  Arguments arguments;
+  for (const lox::expr::Expr& argument : _expr.getArguments()) {
+    arguments.push(lox::Interpreter::evaluate(argument));
+    roots.push(arguments.back());
   }
 
-  if (! instanceof <LoxCallable>(callee)) {
-    throw new RuntimeError(
-        _expr.getParen(), "Can only call functions and classes.");
+  return lox::Interpreter::callValue(
+      callee, receiver, _expr.getParen(), arguments.values());
+}
+
+
+// callee
+//
+// For a call whose callee is a property get and names a method, the method
+// and its receiver are returned separately, so the call passes the receiver
+// straight to the method and no bound method is allocated. A field holding a
+// callable is fetched and called as usual.
+
+Value lox::Interpreter::evaluateCallee(
+    const lox::expr::Call& _expr,
+    Value& receiver,
+    TemporaryRoots& roots) {
+  const lox::expr::Get* get = invokes[_expr.getId()];
+
+  if (get == nullptr) {
+    Value callee = lox::Interpreter::evaluate(_expr.getCallee());
+    roots.push(callee);
+    return callee;
   }
 
-  LoxCallable function = (LoxCallable)callee;
+  Value object = lox::Interpreter::evaluate(get->getObject());
+  roots.push(object);
 
-  if (arguments.size() != function.arity()) {
-    throw RuntimeError(
-        _expr.getParen(),
-        "Expected " + function.arity() + " arguments but got " +
-            arguments.size() + ".");
+  if (!object.is(ObjectType::OBJ_INSTANCE)) {
+    throw RuntimeError(get->getName(), "Only instances have properties.");
+  }
+
+  LoxInstance* instance = object.as<LoxInstance>();
+  LoxFunction* method =
+      methodCaches.at(_expr.getId()).find(instance, get->getName());
+
+  if (method != nullptr) {
+    receiver = object;
+    return method;
+  }
+
+  Value callee =
+      propertyCaches.at(get->getId()).get(instance, get->getName(), heap);
+  roots.push(callee);
+  return callee;
+}
+
+
+Value lox::Interpreter::callValue(
+    const Value& callee,
+    const Value& receiver,
+    const Token& paren,
+    std::span<const Value> arguments) {
+  if (!callee.is(ObjectType::OBJ_FUNCTION) &&
+      !callee.is(ObjectType::OBJ_CLASS)) {
+    throw RuntimeError(paren, "Can only call functions and classes.");
   }
 
-  return function.call(this, arguments);
+  LoxCallable* function = callee.as<LoxCallable>();
+  lox::Interpreter::checkArity(paren, *function, arguments.size());
+
+  if (!receiver.isNil()) {
+    return callee.as<LoxFunction>()->invoke(*this, receiver, arguments);
+  }
+
+  return function->call(*this, arguments);
+}
+
+
+void lox::Interpreter::checkArity(
+    const Token& paren,
+    const LoxCallable& callee,
+    const std::size_t& count) {
+  if (count != static_cast<std::size_t>(callee.getArity())) {
+    throw RuntimeError(
+        paren,
+        "Expected " + std::to_string(callee.getArity()) +
+            " arguments but got " + std::to_string(count) + ".");
+  }
 }
 
 
 // get expr
 
-Object lox::Interpreter::visitGetExpr(const lox::expr::Get& _expr) {
-  Object object = lox::Interpreter::evaluate(_expr.getObject());
+Value lox::Interpreter::visitGetExpr(const lox::expr::Get& _expr) {
+  Value object = lox::Interpreter::evaluate(_expr.getObject());
 
-  if (instanceof <LoxInstance>(object)) {
-    return ((LoxInstance)object).get(_expr.getName());
+  if (object.is(ObjectType::OBJ_INSTANCE)) {
+    // binding a method allocates, and the instance may be reachable from
+    // nowhere else
+    TemporaryRoots roots(heap);
+    roots.push(object);
+    return propertyCaches.at(_expr.getId())
+        .get(object.as<LoxInstance>(), _expr.getName(), heap);
   }
 
-  throw new RuntimeError(_expr.getName(), "Only instances have properties.");
+  throw RuntimeError(_expr.getName(), "Only instances have properties.");
 }
-*/
+
 
 // grouping expr
 
-Object lox::Interpreter::visitGroupingExpr(const lox::expr::Grouping& _expr) {
+Value lox::Interpreter::visitGroupingExpr(const lox::expr::Grouping& _expr) {
   return lox::Interpreter::evaluate(_expr.getExpression());
 }
 
 
 // literal expr
+//
+// Literal values were turned into Values once, when the resolver saw them.
 
-Object lox::Interpreter::visitLiteralExpr(const lox::expr::Literal& _expr) {
-  return _expr.getValue();
+Value lox::Interpreter::visitLiteralExpr(const lox::expr::Literal& _expr) {
+  return constants[_expr.getId()];
 }
 
 
 // logical expr
 
-Object lox::Interpreter::visitLogicalExpr(const lox::expr::Logical& _expr) {
-  Object left = lox::Interpreter::evaluate(_expr.getLeft());
+Value lox::Interpreter::visitLogicalExpr(const lox::expr::Logical& _expr) {
+  Value left = lox::Interpreter::evaluate(_expr.getLeft());
 
   if (_expr.getOp().tokentype() == TokenType::OR) {
-    if (lox::Interpreter::isTruthy(std::get<std::string>(left))) {
+    if (lox::Interpreter::isTruthy(left)) {
       return left;
     }
   } else {
-    if (!lox::Interpreter::isTruthy(std::get<std::string>(left))) {
+    if (!lox::Interpreter::isTruthy(left)) {
       return left;
     }
   }
@@ -414,66 +674,70 @@ Object lox::Interpreter::visitLogicalExpr(const lox::expr::Logical& _expr) {
 
 
 // set expr
-/*
-Object lox::Interpreter::visitSetExpr(const lox::expr::Set& _expr) {
-  Object object = lox::Interpreter::evaluate(_expr.getObject());
 
-  if (!(instanceof <LoxInstance>(object))) {
-    throw new RuntimeError(_expr.getName(), "Only instances have fields.");
+Value lox::Interpreter::visitSetExpr(const lox::expr::Set& _expr) {
+  Value object = lox::Interpreter::evaluate(_expr.getObject());
+
+  if (!object.is(ObjectType::OBJ_INSTANCE)) {
+    throw RuntimeError(_expr.getName(), "Only instances have fields.");
   }
 
-  Object value = lox::Interpreter::evaluate(_expr.getValue());
-  ((LoxInstance)object).set(_expr.getName(), value);
+  TemporaryRoots roots(heap);
+  roots.push(object);
+  Value value = lox::Interpreter::evaluate(_expr.getValue());
+  propertyCaches.at(_expr.getId())
+      .set(object.as<LoxInstance>(), _expr.getName(), value, heap);
 
   return value;
 }
-*/
 
-// super expr
 
-/*
-Object lox::Interpreter::visitSuperExpr(const lox::expr::Super& _expr) {
-  int distance = locals.get(_expr);
+// super expr
 
-  LoxClass superclass = (LoxClass)environment.getAt(distance, "super");
+Value lox::Interpreter::visitSuperExpr(const lox::expr::Super& _expr) {
+  LoxClass* superclass =
+      lox::Interpreter::lookUpVariable(_expr.getKeyword(), _expr.getId())
+          .as<LoxClass>();
 
-  LoxInstance object = (LoxInstance)environment.getAt(distance - 1, "this");
+  LoxInstance* object =
+      lox::Interpreter::lookUpVariable(_expr.getKeyword(), _expr.getThisId())
+          .as<LoxInstance>();
 
-  LoxFunction method = superclass.findMethod(_expr.getMethod().getLexeme());
+  LoxFunction* method = superclass->findMethod(_expr.getMethod().getLexeme());
 
   if (method == nullptr) {
-    throw new RuntimeError(
+    throw RuntimeError(
         _expr.getMethod(),
         "Undefined property '" + _expr.getMethod().getLexeme() + "'.");
   }
 
-  return method.bind(object);
+  return method->bind(object, heap);
 }
-*/
+
 
 // this expr
 
-/*
-Object lox::Interpreter::visitThisExpr(const lox::expr::This& _expr) {
-  return lookUpVariable(_expr.getKeyword(), _expr);
+Value lox::Interpreter::visitThisExpr(const lox::expr::This& _expr) {
+  return lox::Interpreter::lookUpVariable(_expr.getKeyword(), _expr.getId());
 }
-*/
+
 
 // unary expr
 
 
-Object lox::Interpreter::visitUnaryExpr(const lox::expr::Unary& _expr) {
-  std::string right =
-      std::get<std::string>(lox::Interpreter::evaluate(_expr.getRight()));
+Value lox::Interpreter::visitUnaryExpr(const lox::expr::Unary& _expr) {
+  Value right = lox::Interpreter::evaluate(_expr.getRight());
 
   switch (_expr.getOp().tokentype()) {
     case TokenType::BANG:
-      lox::Interpreter::checkNumberOperand(_expr.getOp(), right);
       return !lox::Interpreter::isTruthy(right);
 
     case TokenType::MINUS:
       lox::Interpreter::checkNumberOperand(_expr.getOp(), right);
-      return -std::stod(right);
+      return -right.asNumber();
+
+    default:
+      break;
   }
 
   return nullptr;
@@ -482,41 +746,167 @@ Object lox::Interpreter::visitUnaryExpr(const lox::expr::Unary& _expr) {
 
 // variable expr
 
-/*
-Object lox::Interpreter::visitVariableExpr(const lox::expr::Variable& _expr) {
-  return lox::Interpreter::lookUpVariable(_expr.getName(), _expr);
+
+Value lox::Interpreter::visitVariableExpr(const lox::expr::Variable& _expr) {
+  return lox::Interpreter::lookUpVariable(_expr.getName(), _expr.getId());
 }
 
 
 // resolving and binding look-up-variable
 
 
-Object lox::Interpreter::lookUpVariable(
-    const Token& name,
-    const lox::expr::Expr& _expr) {
-  int distance = locals[_expr];
+Value lox::Interpreter::lookUpVariable(const Token& name, const int& node) {
+  const Binding& binding = bindings[node];
 
-  if (distance != NULL) {
-    return environment.getAt(distance, name.getLexeme());
-  } else {
-    return globals.get(name);
+  switch (binding.kind) {
+    case BindingKind::STACK:
+      return stack[frame.stackBase + binding.index];
+
+    case BindingKind::CELL:
+      return cells[frame.cellBase + binding.index]->get();
+
+    case BindingKind::UPVALUE:
+      return (*frame.upvalues)[binding.index]->get();
+
+    default:
+      return globals.get(binding.index, name);
+  }
+}
+
+
+// record resolver results
+
+
+void lox::Interpreter::resolveBinding(
+    const int& node,
+    const Binding& binding) {
+  bindings.set(node, binding);
+}
+
+
+void lox::Interpreter::resolveFrame(
+    const int& node,
+    const FrameLayout& layout) {
+  if (node == -1) {
+    scriptFrame = layout;
+    return;
   }
+
+  frames.set(node, layout);
+}
+
+
+void lox::Interpreter::resolveCaptures(
+    const int& node,
+    const std::vector<Capture>& list) {
+  captures.set(node, list);
+}
+
+
+// a global gets its slot on first reference, whether or not it has been
+// defined yet; the definition check happens at runtime
+
+void lox::Interpreter::resolveGlobal(
+    const int& node,
+    const std::string& name) {
+  bindings.set(node, Binding{BindingKind::GLOBAL, globals.slot(name)});
+}
+
+
+void lox::Interpreter::resolveInvoke(
+    const int& node,
+    const lox::expr::Get& callee) {
+  invokes.set(node, &callee);
 }
-*/
 
-// helper function
+
+void lox::Interpreter::resolveTailCall(
+    const int& node,
+    const lox::expr::Call& call) {
+  tailCalls.set(node, &call);
+}
 
 
-template <typename base, typename T>
-bool instanceof (const T* ptr) {
-  return dynamic_cast<const base*>(ptr) != nullptr;
+void lox::Interpreter::resolveBlock(
+    const int& node,
+    const lox::stmt::Block& block) {
+  blocks.set(node, &block);
+}
+
+
+// called once the function's own scope has ended, so the receiver and the
+// parameters have their final bindings
+
+void lox::Interpreter::resolvePrototype(
+    const lox::stmt::Function& function,
+    const bool& isMethod,
+    const bool& isInitializer) {
+  auto prototype = std::make_unique<FunctionPrototype>();
+  prototype->declaration = &function;
+  prototype->body = &function.getBody();
+  prototype->name = function.getName().getLexeme();
+  prototype->arity = function.getParams().size();
+  prototype->isInitializer = isInitializer;
+
+  if (isMethod) {
+    prototype->receiver = bindings[function.getId()];
+  }
+
+  for (int i = 0; i < prototype->arity; i++) {
+    prototype->params.push_back(bindings[function.getParamId(i)]);
+  }
+
+  functionPrototypes.set(function.getId(), prototype.get());
+  prototypes.push_back(std::move(prototype));
+}
+
+
+// how often each function that ran was entered, tail calls included
+
+void lox::Interpreter::reportCalls(std::ostream& out) const {
+  for (const auto& prototype : prototypes) {
+    if (prototype->calls != 0) {
+      out << "[calls] " << prototype->name << ": " << prototype->calls
+          << "\n";
+    }
+  }
+  out.flush();
+}
+
+
+void lox::Interpreter::resolveFusion(const int& node, const Fusion& fusion) {
+  fusions.set(node, fusion);
+  fusionSites[static_cast<int>(fusion.pattern)]++;
+}
+
+
+// sites the fuser found and how often their fused step ran, per pattern
+
+void lox::Interpreter::reportFusion(std::ostream& out) const {
+  static const char* names[PATTERN_COUNT] = {
+      "none", "increment local", "compare and branch", "field update",
+      "copy local", "counted loop"};
+
+  for (int i = 1; i < PATTERN_COUNT; i++) {
+    out << "[fusion] " << names[i] << ": " << fusionSites[i] << " sites, "
+        << fusionRuns[i] << " runs\n";
+  }
+  out.flush();
+}
+
+
+// literals are resolved to Values once, so evaluating a string literal does
+// not allocate
+
+void lox::Interpreter::resolveConstant(const int& node, const Value& value) {
+  constants.set(node, value);
 }
 
 
 // evaluate
 
 
-Object lox::Interpreter::evaluate(const lox::expr::Expr& _expr) {
+Value lox::Interpreter::evaluate(const lox::expr::Expr& _expr) {
   return _expr.accept(*this);
 }
 
@@ -526,8 +916,8 @@ Object lox::Interpreter::evaluate(const lox::expr::Expr& _expr) {
 
 void lox::Interpreter::checkNumberOperand(
     const Token& op,
-    const std::string& operand) {
-  if (std::is_same<decltype(operand), double>::value) {
+    const Value& operand) {
+  if (operand.isNumber()) {
     return;
   }
 
@@ -538,16 +928,13 @@ void lox::Interpreter::checkNumberOperand(
 // check truth value
 
 
-bool lox::Interpreter::isTruthy(const std::string& object) {
-  if (object.empty()) {
+bool lox::Interpreter::isTruthy(const Value& object) {
+  if (object.isNil()) {
     return false;
   }
 
-  if (std::is_same<decltype(object), bool>::value) {
-    // https://stackoverflow.com/questions/2165921
-    bool b;
-    std::istringstream(object) >> std::boolalpha >> b;
-    return b;
+  if (object.isBool()) {
+    return object.asBool();
   }
 
   return true;
@@ -559,10 +946,9 @@ bool lox::Interpreter::isTruthy(const std::string& object) {
 
 void lox::Interpreter::checkNumberOperands(
     const Token& op,
-    const std::string& left,
-    const std::string& right) {
-  if ((std::is_same<decltype(left), double>::value) &&
-      (std::is_same<decltype(right), double>::value)) {
+    const Value& left,
+    const Value& right) {
+  if (left.isNumber() && right.isNumber()) {
     return;
   }
   throw RuntimeError(op, "Operands must be numbers.");
@@ -572,63 +958,117 @@ void lox::Interpreter::checkNumberOperands(
 // check if equal
 
 
-bool lox::Interpreter::isEqual(const std::string& a, const std::string& b) {
-  if (a.empty() && b.empty()) {
-    return true;
+// + on operands of any type, for nodes whose specialization failed
+
+lox::Value lox::Interpreter::add(
+    const Token& op,
+    const Value& a,
+    const Value& b) {
+  if (a.isNumber() && b.isNumber()) {
+    return a.asNumber() + b.asNumber();
   }
-  if (a.empty()) {
-    return false;
+
+  if (a.is(ObjectType::OBJ_STRING) && b.is(ObjectType::OBJ_STRING)) {
+    return lox::Interpreter::concatenate(a.as<LoxString>(), b.as<LoxString>());
   }
-  return a == b;
+
+  throw RuntimeError(op, "Operands must be two numbers or two strings.");
 }
 
 
-// interpret
+// both strings are copied out before the result is allocated, so a
+// collection it triggers may free them
 
+lox::Value lox::Interpreter::concatenate(
+    const LoxString* a,
+    const LoxString* b) {
+  std::string chars;
+  chars.reserve(a->length() + b->length());
+  chars.append(a->getChars()).append(b->getChars());
 
-void lox::Interpreter::interpret(const lox::expr::Expr& expression) {
-  try {
-    Object result = lox::Interpreter::evaluate(expression);
-    std::string value;
+  return heap.allocate<LoxString>(std::move(chars));
+}
 
-    if (std::holds_alternative<std::nullptr_t>(result)) {
-      value = "nullptr";
 
-    } else if (std::holds_alternative<std::string>(result)) {
-      value = std::get<std::string>(result);
+bool lox::Interpreter::isEqual(const Value& a, const Value& b) {
+  if (a.isNumber() && b.isNumber()) {
+    // NaN is not equal to itself
+    return a.asNumber() == b.asNumber();
+  }
 
-    } else if (std::holds_alternative<double>(result)) {
-      value = std::to_string(std::get<double>(result));
+  // identity and the cached hash settle most string comparisons before the
+  // characters are looked at
+  if (a.is(ObjectType::OBJ_STRING) && b.is(ObjectType::OBJ_STRING)) {
+    return a.as<LoxString>()->equals(*b.as<LoxString>());
+  }
 
-    } else if (std::holds_alternative<bool>(result)) {
-      value = std::get<bool>(result) ? "true" : "false";
-    }
-    std::cout << lox::Interpreter::stringify(value);
+  return a.getBits() == b.getBits();
+}
 
-  } catch (RuntimeError error) {
+
+// interpret
+
+
+void lox::Interpreter::interpret(const lox::expr::Expr& expression) {
+  try {
+    lox::Interpreter::print(lox::Interpreter::evaluate(expression));
+
+  } catch (const RuntimeError& error) {
     Lox _lox;
     _lox.runtimeError(error);
   }
 }
 
 
+// shortest text that reads back as the same double, so 3.0 prints as 3;
+// written into the caller's buffer
+
+static std::string_view formatNumber(
+    const double& number,
+    char* text,
+    const std::size_t& size) {
+  auto result = std::to_chars(text, text + size, number);
+  return std::string_view(text, result.ptr - text);
+}
+
+
 // convert to string
 
 
-std::string lox::Interpreter::stringify(const std::string& object) {
-  if (object.empty()) {
-    return nullptr;
+std::string lox::Interpreter::stringify(const Value& object) {
+  if (object.isNil()) {
+    return "nil";
   }
 
-  if (std::is_same<decltype(object), double>::value) {
-    std::string text = std::string(object);
-    if (text.ends_with(".0")) {
-      text = text.substr(0, text.length() - 2);
-    }
-    return text;
+  if (object.isBool()) {
+    return object.asBool() ? "true" : "false";
+  }
+
+  if (object.isNumber()) {
+    char text[32];
+    return std::string(formatNumber(object.asNumber(), text, sizeof(text)));
+  }
+
+  return object.asObject()->to_string();
+}
+
+
+// print a value on a line of its own; numbers and strings go to the output
+// without a std::string being made for them
+
+void lox::Interpreter::print(const Value& object) {
+  if (object.isNumber()) {
+    char text[32];
+    output.write(formatNumber(object.asNumber(), text, sizeof(text)));
+
+  } else if (object.is(ObjectType::OBJ_STRING)) {
+    output.write(object.as<LoxString>()->getChars());
+
+  } else {
+    output.write(lox::Interpreter::stringify(object));
   }
 
-  return std::string(object);
+  output.endLine();
 }
 
 
@@ -4,72 +4,399 @@
 #define INTERPRETER_H
 
 #include <string.h>
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <ostream>
+#include <memory>
+#include <span>
+#include <string>
 #include <unordered_map>
 #include <vector>
 
-#include "Environment.h"
+#include "CellPool.h"
 #include "Expr.h"
+#include "GlobalTable.h"
+#include "Heap.h"
+#include "InlineCache.h"
+#include "Output.h"
+#include "Script.h"
+#include "SideTable.h"
 #include "Stmt.h"
+#include "Upvalue.h"
+#include "Value.h"
 
 
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
-
 namespace lox {
 
-class Interpreter : public lox::expr::Visitor<Object>,
-                    public lox::stmt::Visitor<void> {
+class LoxCallable;
+class LoxString;
+
+
+// where the resolver placed a declared name or the name an expression uses
+
+enum BindingKind {
+  UNRESOLVED,
+  STACK,
+  CELL,
+  UPVALUE,
+  GLOBAL,
+};
+
+
+struct Binding {
+  BindingKind kind = BindingKind::UNRESOLVED;
+  int index = -1;
+};
+
+
+// stack slots and captured cells a function's frame needs
+
+struct FrameLayout {
+  int slots = 0;
+  int cells = 0;
+};
+
+
+// a variable a closure captures when it is created: either a cell of the
+// enclosing frame or one of the enclosing closure's own captures
+
+struct Capture {
+  bool local;
+  int index;
+};
+
+
+using Upvalues = std::vector<std::shared_ptr<Upvalue>>;
+
+
+// what every closure over one function declaration shares; made by the
+// resolver once the function's locals are placed, and left alone after that
+// apart from its call count
+
+struct FunctionPrototype {
+  const lox::stmt::Function* declaration = nullptr;
+  const std::vector<lox::stmt::Stmt>* body = nullptr;
+  std::string name;
+  int arity = 0;
+  bool isInitializer = false;
+  // where a method's receiver and each argument are defined on entry
+  Binding receiver;
+  std::vector<Binding> params;
+  mutable std::uint64_t calls = 0;
+};
+
+
+// a group of nodes the fuser found and that runs as a single step; see Fuser
+
+enum class Pattern {
+  NONE,
+  // i = i + 1
+  INCREMENT_LOCAL,
+  // if (a < b) / while (a < b)
+  COMPARE_BRANCH,
+  // x.y = x.y + z
+  FIELD_UPDATE,
+  // var t = a;
+  COPY_LOCAL,
+  // for (var i = a; i < n; i = i + 1)
+  COUNTED_LOOP,
+};
+
+constexpr int PATTERN_COUNT = 6;
+
+
+// an operand read straight from the running frame's stack, or a number
+// constant when slot is -1
+
+struct Operand {
+  int slot = -1;
+  double constant = 0;
+};
+
+
+struct Fusion {
+  Pattern pattern = Pattern::NONE;
+  // the arithmetic or comparison folded in, for its operator token
+  const lox::expr::Binary* operation = nullptr;
+  // the field read of a FIELD_UPDATE
+  const lox::expr::Get* field = nullptr;
+  Operand left;
+  Operand right;
+  // a COUNTED_LOOP's body without its increment, the increment and the
+  // constant it adds
+  const lox::stmt::Stmt* body = nullptr;
+  const lox::stmt::Stmt* increment = nullptr;
+  double step = 0;
+};
+
+
+// how a statement finished; a return statement unwinds through the
+// enclosing blocks and loops by handing this back, not by throwing. A return
+// whose value is a call finishes with TAIL_CALL and leaves the call for the
+// function being returned from to make in its place.
+
+enum class Completion {
+  NORMAL,
+  RETURN,
+  TAIL_CALL,
+};
+
+
+// an AST node converted once into a callable that runs it; see
+// ClosureCompiler
+
+using CompiledExpr = std::function<Value()>;
+using CompiledStmt = std::function<Completion()>;
+// an expression in a branch or loop condition, yielding its truth directly
+using CompiledCondition = std::function<bool()>;
+
+
+// the pending call of a TAIL_CALL completion; see LoxFunction::invoke
+
+struct TailCall {
+  Value callee;
+  // nil unless the callee is a method looked up on this receiver
+  Value receiver;
+  std::vector<Value> arguments;
+};
+
+
+// the running frame, saved across calls
+
+struct CallFrame {
+  int stackBase;
+  int cellBase;
+  const Upvalues* upvalues;
+};
+
+
+class Interpreter : public lox::expr::Visitor<Value>,
+                    public lox::stmt::Visitor<Completion>,
+                    public RootSource {
  private:
-  Environment globals;  // = new Environment();
-  Environment environment;  // = globals;
-  std::unordered_map<lox::expr::Expr, int> locals;
+  // declared first so it outlives every structure holding object pointers
+  Heap heap;
+  // every script run so far; the tables below point into their nodes
+  std::vector<std::unique_ptr<Script>> scripts;
+  GlobalTable globals;
+  SideTable<Binding> bindings;
+  SideTable<FrameLayout> frames;
+  SideTable<std::vector<Capture>> captures;
+  SideTable<Value> constants;
+  SideTable<PropertyCache> propertyCaches;
+  // calls whose callee is a property get, and the methods they have run
+  SideTable<const lox::expr::Get*> invokes;
+  SideTable<MethodCache> methodCaches;
+  // fused node groups by root node, and how often each pattern was found
+  // and ran
+  SideTable<Fusion> fusions;
+  std::array<std::uint64_t, PATTERN_COUNT> fusionSites{};
+  std::array<std::uint64_t, PATTERN_COUNT> fusionRuns{};
+  FrameLayout scriptFrame;
+
+  // locals no closure captures live in this contiguous stack; captured
+  // locals are boxed in cells, and a closure carries exactly the cells it
+  // refers to
+  std::vector<Value> stack;
+  Upvalues cells;
+  CellPool cellPool;
+  // what print statements write, in every engine
+  Output output;
+  CallFrame frame{0, 0, nullptr};
+  // set by a return statement, read by the call that completes
+  Value returnValue;
+  TailCall tailCall;
+  // return statements whose value is a call in tail position
+  SideTable<const lox::expr::Call*> tailCalls;
+  // block statements, which set up no scope and can be run inline
+  SideTable<const lox::stmt::Block*> blocks;
+  // one prototype per function declaration, in the order they were resolved
+  std::vector<std::unique_ptr<FunctionPrototype>> prototypes;
+  SideTable<const FunctionPrototype*> functionPrototypes;
+
+  // function bodies converted by the closure compiler, by declaration
+  SideTable<CompiledStmt> bodies;
+
+  friend class ClosureCompiler;
+
+  void prepareScriptFrame();
 
  public:
-  // Interpreter() : globals(Environment()), environment(globals) {}
-
-  void visitBlockStmt(const lox::stmt::Block& _stmt);
-  void visitClassStmt(const lox::stmt::Class& _stmt);
-  void visitExpressionStmt(const lox::stmt::Expression& _stmt);
-  void visitFunctionStmt(const lox::stmt::Function& _stmt);
-  void visitIfStmt(const lox::stmt::If& _stmt);
-  void visitPrintStmt(const lox::stmt::Print& _stmt);
-  void visitReturnStmt(const lox::stmt::Return& _stmt);
-  void visitVarStmt(const lox::stmt::Var& _stmt);
-  void visitWhileStmt(const lox::stmt::While& _stmt);
+  Interpreter() {
+    heap.addRoots(this);
+  }
+
+  Interpreter(const Interpreter&) = delete;
+  Interpreter& operator=(const Interpreter&) = delete;
+
+  Completion visitBlockStmt(const lox::stmt::Block& _stmt);
+  Completion visitClassStmt(const lox::stmt::Class& _stmt);
+  Completion visitExpressionStmt(const lox::stmt::Expression& _stmt);
+  Completion visitFunctionStmt(const lox::stmt::Function& _stmt);
+  Completion visitIfStmt(const lox::stmt::If& _stmt);
+  Completion visitPrintStmt(const lox::stmt::Print& _stmt);
+  Completion visitReturnStmt(const lox::stmt::Return& _stmt);
+  Completion visitVarStmt(const lox::stmt::Var& _stmt);
+  Completion visitWhileStmt(const lox::stmt::While& _stmt);
 
   void interpret(const std::vector<lox::stmt::Stmt>& statements);
-  void execute(const lox::stmt::Stmt& _stmt);
+  Completion execute(const lox::stmt::Stmt& _stmt);
   // void evaluate(const lox::stmt::Stmt& _stmt);
-  void resolve(const lox::expr::Expr& _expr, const int& depth);
-  void executeBlock(
-      const std::vector<lox::stmt::Stmt>& statements,
-      const Environment& environment);
-  Object lookUpVariable(const Token& name, const lox::expr::Expr& _expr);
-
-  Object visitAssignExpr(const lox::expr::Assign& _expr);
-  Object visitBinaryExpr(const lox::expr::Binary& _expr);
-  Object visitCallExpr(const lox::expr::Call& _expr);
-  Object visitGetExpr(const lox::expr::Get& _expr);
-  Object visitGroupingExpr(const lox::expr::Grouping& _expr);
-  Object visitLiteralExpr(const lox::expr::Literal& _expr);
-  Object visitLogicalExpr(const lox::expr::Logical& _expr);
-  Object visitSetExpr(const lox::expr::Set& _expr);
-  Object visitSuperExpr(const lox::expr::Super& _expr);
-  Object visitThisExpr(const lox::expr::This& _expr);
-  Object visitUnaryExpr(const lox::expr::Unary& _expr);
-  Object visitVariableExpr(const lox::expr::Variable& _expr);
-
-  Object evaluate(const lox::expr::Expr& _expr);
-
-  void checkNumberOperand(const Token& op, const std::string& operand);
-  bool isTruthy(const std::string& object);
+  void resolveBinding(const int& node, const Binding& binding);
+  void resolveFrame(const int& node, const FrameLayout& layout);
+  void resolveCaptures(const int& node, const std::vector<Capture>& list);
+  void resolveGlobal(const int& node, const std::string& name);
+  void resolveConstant(const int& node, const Value& value);
+  void resolveInvoke(const int& node, const lox::expr::Get& callee);
+  void resolveTailCall(const int& node, const lox::expr::Call& call);
+  void resolveBlock(const int& node, const lox::stmt::Block& block);
+  void resolvePrototype(
+      const lox::stmt::Function& function,
+      const bool& isMethod,
+      const bool& isInitializer);
+  void reportCalls(std::ostream& out) const;
+  void resolveFusion(const int& node, const Fusion& fusion);
+  void reportFusion(std::ostream& out) const;
+  Completion executeBlock(const std::vector<lox::stmt::Stmt>& statements);
+  Completion executeBody(const FunctionPrototype& prototype);
+  void interpret(const CompiledStmt& script);
+  CallFrame pushFrame(const int& node, const Upvalues* upvalues);
+  void popFrame(const CallFrame& previous);
+  void define(const int& node, const Value& value);
+  void define(const Binding& binding, const Value& value);
+  void store(const int& node, const Value& value);
+  void store(const Binding& binding, const Value& value);
+  Upvalues capture(const int& node) const;
+  Value takeReturnValue();
+  Completion scheduleTailCall(
+      const Value& callee,
+      const Value& receiver,
+      const Token& paren,
+      std::span<const Value> arguments);
+  void markRoots(Heap& heap);
+
+  Heap& getHeap() {
+    return heap;
+  }
+
+  GlobalTable& getGlobals() {
+    return globals;
+  }
+
+  CellPool& getCellPool() {
+    return cellPool;
+  }
+
+  Output& getOutput() {
+    return output;
+  }
+
+  // where the next script or REPL line is parsed into; it is kept until
+  // the interpreter goes away
+  Script& addScript() {
+    scripts.push_back(std::make_unique<Script>());
+    return *scripts.back();
+  }
+
+  // resolver results, shared with the bytecode compiler
+
+  const Binding& getBinding(const int& node) const {
+    return bindings[node];
+  }
+
+  const FrameLayout& getFrameLayout(const int& node) const {
+    return node == -1 ? scriptFrame : frames[node];
+  }
+
+  const std::vector<Capture>& getCaptures(const int& node) const {
+    return captures[node];
+  }
+
+  const Value& getConstant(const int& node) const {
+    return constants[node];
+  }
+
+  const SideTable<PropertyCache>& getPropertyCaches() const {
+    return propertyCaches;
+  }
+
+  const SideTable<MethodCache>& getMethodCaches() const {
+    return methodCaches;
+  }
+
+  const lox::expr::Get* getInvoke(const int& node) const {
+    return invokes[node];
+  }
+
+  const lox::expr::Call* getTailCall(const int& node) const {
+    return tailCalls[node];
+  }
+
+  const FunctionPrototype* getPrototype(const int& node) const {
+    return functionPrototypes[node];
+  }
+
+  const lox::stmt::Block* getBlock(const int& node) const {
+    return blocks[node];
+  }
+
+  const Fusion& getFusion(const int& node) const {
+    return fusions[node];
+  }
+
+  TailCall& getPendingTailCall() {
+    return tailCall;
+  }
+
+  // number of global slots handed out so far, for memory reporting
+  std::size_t globalSlotCount() const {
+    return globals.size();
+  }
+
+  Value lookUpVariable(const Token& name, const int& node);
+
+  Value visitAssignExpr(const lox::expr::Assign& _expr);
+  Value visitBinaryExpr(const lox::expr::Binary& _expr);
+  Value visitCallExpr(const lox::expr::Call& _expr);
+  Value visitGetExpr(const lox::expr::Get& _expr);
+  Value visitGroupingExpr(const lox::expr::Grouping& _expr);
+  Value visitLiteralExpr(const lox::expr::Literal& _expr);
+  Value visitLogicalExpr(const lox::expr::Logical& _expr);
+  Value visitSetExpr(const lox::expr::Set& _expr);
+  Value visitSuperExpr(const lox::expr::Super& _expr);
+  Value visitThisExpr(const lox::expr::This& _expr);
+  Value visitUnaryExpr(const lox::expr::Unary& _expr);
+  Value visitVariableExpr(const lox::expr::Variable& _expr);
+
+  Value evaluate(const lox::expr::Expr& _expr);
+  Value evaluateCallee(
+      const lox::expr::Call& _expr,
+      Value& receiver,
+      TemporaryRoots& roots);
+  Value callValue(
+      const Value& callee,
+      const Value& receiver,
+      const Token& paren,
+      std::span<const Value> arguments);
+  void checkArity(
+      const Token& paren,
+      const LoxCallable& callee,
+      const std::size_t& count);
+
+  void checkNumberOperand(const Token& op, const Value& operand);
+  bool isTruthy(const Value& object);
   void checkNumberOperands(
       const Token& op,
-      const std::string& left,
-      const std::string& right);
-  bool isEqual(const std::string& a, const std::string& b);
+      const Value& left,
+      const Value& right);
+  bool isEqual(const Value& a, const Value& b);
+  Value add(const Token& op, const Value& a, const Value& b);
+  Value concatenate(const LoxString* a, const LoxString* b);
 
   void interpret(const lox::expr::Expr& expression);
-  std::string stringify(const std::string& object);
+  std::string stringify(const Value& object);
+  void print(const Value& object);
 };
 
 
@@ -1,8 +1,14 @@
-#include <iostream>
-
 #include "Lox.h"
 
 
-// We don't need this file; the content shifted to main.cpp
+namespace lox {
+
+// one interpreter for the whole process, so globals and side tables carry
+// over from one REPL line to the next
+
+bool lox::Lox::hadError = false;
+bool lox::Lox::hadRuntimeError = false;
+lox::Interpreter lox::Lox::interpreter;
+
 
-namespace lox {}  // namespace lox
+}  // namespace lox
@@ -10,41 +10,121 @@
 #include <functional>
 #include <iostream>
 #include <sstream>
+#include <string>
 #include <vector>
 
 //#include "ASTPrinter.h"
 #include "Expr.h"
+#include "ClosureCompiler.h"
+#include "Compiler.h"
+#include "Fuser.h"
 #include "Interpreter.h"
 #include "Parser.h"
-//#include "Resolver.h"
+#include "Resolver.h"
 #include "RuntimeError.h"
 #include "Scanner.h"
 #include "Stmt.h"
 #include "Token.h"
+#include "VM.h"
 
 
 namespace lox {
 
+// which backend runs a resolved program; the tree-walker is the reference
+
+enum class Engine {
+  TREE,
+  CLOSURE,
+  VM,
+};
+
+
 class Lox {
  private:
-  bool hadError = false;
-  bool hadRuntimeError = false;
+  // the parser, resolver and interpreter each report through a Lox of
+  // their own, so the flags live with the class rather than an instance
+  static bool hadError;
+  static bool hadRuntimeError;
+  bool gcStats = false;
+  bool cacheStats = false;
+  bool fusionStats = false;
+  bool callStats = false;
+  // node IDs handed out so far; the interpreter's side tables outlive a
+  // run, so each REPL line continues the numbering of the ones before it
+  int nodeCount = 0;
+  Engine engine = Engine::TREE;
   static lox::Interpreter interpreter;
 
  public:
+  // print collector statistics to stderr once the script has run
+  void enableGcStats() {
+    gcStats = true;
+  }
+
+  // print inline cache hit rates to stderr once the script has run
+  void enableCacheStats() {
+    cacheStats = true;
+  }
+
+  // print how often each fused pattern was found and ran
+  void enableFusionStats() {
+    fusionStats = true;
+  }
+
+  // print how many times each function was entered
+  void enableCallStats() {
+    callStats = true;
+  }
+
+  void setEngine(const Engine& selected) {
+    engine = selected;
+  }
+
+  lox::Heap& getHeap() {
+    return interpreter.getHeap();
+  }
+
+  lox::Output& getOutput() {
+    return interpreter.getOutput();
+  }
+
   void runFile(const std::string& path) {
     try {
       // https://stackoverflow.com/questions/38032800
-      std::fstream bytes{path.c_str(), std::ios::binary};
+      std::ifstream bytes{path.c_str(), std::ios::binary};
       // https://stackoverflow.com/questions/2602013
       std::stringstream buffer;
       buffer << bytes.rdbuf();
       run(buffer.str());
     } catch (const std::exception& e) {
+      interpreter.getOutput().flush();
       std::cerr << "Exception: " << e.what() << std::endl;
       return;
     }
 
+    // what the script printed comes before the statistics
+    interpreter.getOutput().flush();
+
+    if (gcStats) {
+      interpreter.getHeap().report(std::cerr);
+      interpreter.getCellPool().report(std::cerr);
+    }
+
+    if (fusionStats) {
+      interpreter.reportFusion(std::cerr);
+    }
+
+    if (callStats) {
+      interpreter.reportCalls(std::cerr);
+    }
+
+    if (cacheStats) {
+      lox::reportCaches(
+          interpreter.getPropertyCaches(),
+          interpreter.getMethodCaches(),
+          std::cerr);
+    }
+
     if (hadError) {
       std::exit(1);
     }
@@ -60,7 +140,8 @@ class Lox {
     std::ifstream file(input);
 
     for (;;) {
-      std::cout << "> ";
+      interpreter.getOutput().write("> ");
+      interpreter.getOutput().flush();
       std::string line;
       std::getline(file, line);
       // https://stackoverflow.com/questions/462165
@@ -74,31 +155,37 @@ class Lox {
   }
 
   void run(const std::string& source) {
+    lox::Script& script = interpreter.addScript();
     lox::Scanner scanner(source);
-    std::vector<Token> tokens = scanner.scanTokens();
-    for (Token token : tokens) {
-      // TODO: check another way (https://stackoverflow.com/questions/45172025)
-      std::cout << token;
-    }
+    script.tokens = scanner.scanTokens();
 
-    lox::parser::Parser parser(tokens);
-    lox::expr::Expr expression = parser.parse();
-    std::vector<lox::stmt::Stmt> statements = parser.parseStmt();
+    lox::parser::Parser parser(script, nodeCount);
+    script.statements = parser.parseStmt();
+    nodeCount = parser.getNodeCount();
 
     // To ensure code has error and we have to return the program
     if (hadError) {
       return;
     }
 
-    // lox::Resolver resolver(interpreter);
-    //   resolver.resolve(statements);
+    lox::Resolver resolver(interpreter);
+    resolver.resolve(script.statements);
+    lox::Fuser(interpreter).fuse(script.statements);
 
     if (hadError) {
       return;
     }
 
     // std::cout << ASTPrinter().print(expression);
-    // interpreter.interpret(statements);
+    if (engine == Engine::VM) {
+      lox::VM vm(interpreter);
+      vm.interpret(lox::Compiler(interpreter).compile(script.statements));
+    } else if (engine == Engine::CLOSURE) {
+      interpreter.interpret(
+          lox::ClosureCompiler(interpreter).compile(script.statements));
+    } else {
+      interpreter.interpret(script.statements);
+    }
   }
 
 
@@ -110,7 +197,10 @@ class Lox {
       const int& line,
       const std::string& where,
       const std::string& message) {
-    std::cout << "[line " << line << "] Error" << where << ": " << message;
+    // what the script printed so far comes first
+    interpreter.getOutput().flush();
+    std::cerr << "[line " << line << "] Error" << where << ": " << message
+              << std::endl;
     hadError = true;
   }
 
@@ -123,7 +213,9 @@ class Lox {
   }
 
   void runtimeError(const RuntimeError& error) {
-    std::cerr << error.what() << "[" << error.getToken().getLine() << "]";
+    interpreter.getOutput().flush();
+    std::cerr << error.what() << std::endl
+              << "[line " << error.getToken().getLine() << "]" << std::endl;
     hadRuntimeError = true;
     std::exit(1);
   }
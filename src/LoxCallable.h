@@ -1,24 +1,78 @@
 #ifndef LOXCALLABLE_H
 #define LOXCALLABLE_H
 
+#include <array>
+#include <span>
 #include <string>
-#include <variant>
 #include <vector>
 
 #include "Interpreter.h"
+#include "LoxObject.h"
+#include "Value.h"
 
 
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
+namespace lox {
 
+// The values a call site evaluated for one call. The first INLINE_ARGUMENTS
+// live inside the buffer itself, so calls with few arguments allocate
+// nothing; longer lists move into a vector so the span stays contiguous.
 
-namespace lox {
+class Arguments {
+ private:
+  static constexpr std::size_t INLINE_ARGUMENTS = 8;
+
+  std::array<Value, INLINE_ARGUMENTS> buffer;
+  std::vector<Value> spill;
+  std::size_t count = 0;
+
+ public:
+  void push(const Value& value) {
+    if (count < INLINE_ARGUMENTS) {
+      buffer[count] = value;
+    } else {
+      if (count == INLINE_ARGUMENTS) {
+        spill.assign(buffer.begin(), buffer.end());
+      }
+      spill.push_back(value);
+    }
+    count++;
+  }
+
+  const Value& back() const {
+    return count <= INLINE_ARGUMENTS ? buffer[count - 1] : spill.back();
+  }
+
+  std::size_t size() const {
+    return count;
+  }
+
+  std::span<const Value> values() const {
+    if (count <= INLINE_ARGUMENTS) {
+      return std::span<const Value>(buffer.data(), count);
+    }
+    return std::span<const Value>(spill);
+  }
+};
+
+
+// Anything a call expression can call. The arity is stored with the object
+// so a call site checks it without a virtual call.
+
+class LoxCallable : public LoxObject {
+ protected:
+  int arity;
 
-class LoxCallable {
  public:
-  virtual int arity() = 0;
-  virtual Object call(
+  LoxCallable(const ObjectType& type, const int& arity)
+      : LoxObject(type), arity(arity) {}
+
+  int getArity() const {
+    return arity;
+  }
+
+  virtual Value call(
       const lox::Interpreter& interpreter,
-      const std::vector<Object>& arguments) = 0;
+      std::span<const Value> arguments) = 0;
 };
 
 
@@ -1,15 +1,14 @@
+#include <span>
 #include <string>
 #include <unordered_map>
-#include <variant>
 #include <vector>
 
+#include "Heap.h"
 #include "Interpreter.h"
 #include "LoxClass.h"
 #include "LoxFunction.h"
 #include "LoxInstance.h"
-
-
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
+#include "Value.h"
 
 
 namespace lox {
@@ -17,57 +16,89 @@ namespace lox {
 
 LoxClass::LoxClass(
     const std::string& name,
-    const LoxClass& superclass,
-    const std::unordered_map<std::string, LoxFunction>& methods)
-    : superclass(superclass), name(name), methods(methods) {}
+    LoxClass* superclass,
+    const std::unordered_map<std::string, LoxFunction*>& methods)
+    : LoxCallable(ObjectType::OBJ_CLASS, 0),
+      name(name),
+      superclass(superclass) {
+  // the superclass's table is already flattened, so copying it brings in the
+  // whole chain; this class's own methods then override
+  if (superclass != nullptr) {
+    LoxClass::methods = superclass->methods;
+  }
 
+  for (const auto& method : methods) {
+    LoxClass::methods[method.first] = method.second;
+  }
 
-lox::LoxFunction LoxClass::findMethod(const std::string& name) {
+  // calling the class takes the initializer's parameters
+  LoxFunction* initializer = LoxClass::findMethod("init");
+  if (initializer != nullptr) {
+    arity = initializer->getArity();
+  }
+}
+
+
+// one lookup whatever the depth of the hierarchy, since inherited methods
+// were copied in when the class was created
+
+LoxFunction* LoxClass::findMethod(const std::string& name) {
   auto it = methods.find(name);
 
   if (it != methods.end()) {
-    return methods.at(name);
+    return it->second;
   }
 
-  if (superclass != nullptr) {
-    return findMethod(name);  // TODO
+  return nullptr;
+}
+
+
+void LoxClass::trace(Heap& heap) const {
+  heap.mark(superclass);
+
+  for (const auto& method : methods) {
+    heap.mark(method.second);
   }
-  // return nullptr;
 }
 
 
-std::string LoxClass::to_string() {
+std::size_t LoxClass::byteSize() const {
+  return sizeof(LoxClass) + name.capacity() +
+         methods.size() * (sizeof(std::string) + sizeof(LoxFunction*));
+}
+
+
+std::string LoxClass::to_string() const {
   return name;
 }
 
 
-Object LoxClass::call(
+Value LoxClass::call(
     const Interpreter& interpreter,
-    const std::vector<Object>& arguments) {
-  LoxInstance* instance = new LoxInstance(*this);
-  LoxFunction initializer = LoxClass::findMethod("init");
+    std::span<const Value> arguments) {
+  Interpreter& _interpreter = const_cast<Interpreter&>(interpreter);
+  Heap& heap = _interpreter.getHeap();
+  TemporaryRoots roots(heap);
+
+  LoxInstance* instance = heap.allocate<LoxInstance>(this);
+  roots.push(instance);
+  LoxFunction* initializer = LoxClass::findMethod("init");
 
   if (initializer != nullptr) {
-    initializer.bind(instance).call(interpreter, arguments);
+    initializer->invoke(interpreter, instance, arguments);
   }
 
-  // return instance;  // TODO
+  return instance;
 }
 
 
-int LoxClass::arity() {
-  LoxFunction initializer = LoxClass::findMethod("init");
-
-  if (initializer == nullptr) {
-    return 0;
-  }
-
-  return initializer.arity();
+const std::string& LoxClass::getName() const {
+  return name;
 }
 
 
-const std::string& LoxClass::getName() {
-  return name;
+Shape* LoxClass::getRootShape() {
+  return &rootShape;
 }
 
 }  // namespace lox
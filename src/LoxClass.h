@@ -1,16 +1,15 @@
 #ifndef LOXCLASS_H
 #define LOXCLASS_H
 
+#include <span>
 #include <string>
 #include <unordered_map>
-#include <variant>
 #include <vector>
 
 #include "Interpreter.h"
 #include "LoxCallable.h"
-
-
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
+#include "Shape.h"
+#include "Value.h"
 
 
 namespace lox {
@@ -22,39 +21,28 @@ class LoxFunction;
 class LoxClass : public lox::LoxCallable {
  private:
   std::string name;
-  const LoxClass& superclass;
-  std::unordered_map<std::string, LoxFunction> methods;
+  LoxClass* superclass;
+  // every method an instance responds to, inherited ones included
+  std::unordered_map<std::string, LoxFunction*> methods;
+  // the empty layout new instances start from
+  Shape rootShape;
 
  public:
-  friend bool operator==(const LoxClass& _x, const LoxClass& _y) {
-    return _x == _y;
-  }
-
-  bool operator==(const std::nullptr_t& _y) const {
-    return *this == _y;
-  }
-
-  friend bool operator!=(const LoxClass& _x, const LoxClass& _y) {
-    return _x != _y;
-  }
-
-  bool operator!=(const std::nullptr_t& _y) const {
-    return !(*this == _y);
-  }
-
   LoxClass(
       const std::string& name,
-      const LoxClass& superclass,
-      const std::unordered_map<std::string, LoxFunction>& methods);
-
-  lox::LoxFunction findMethod(const std::string& name);
-  std::string to_string();
-  Object call(
+      LoxClass* superclass,
+      const std::unordered_map<std::string, LoxFunction*>& methods);
+
+  LoxFunction* findMethod(const std::string& name);
+  void trace(Heap& heap) const;
+  std::size_t byteSize() const;
+  std::string to_string() const;
+  Value call(
       const lox::Interpreter& interpreter,
-      const std::vector<Object>& arguments);
-  int arity();
+      std::span<const Value> arguments);
 
-  const std::string& getName();
+  const std::string& getName() const;
+  Shape* getRootShape();
 };
 
 
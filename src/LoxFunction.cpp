@@ -1,72 +1,138 @@
+#include <span>
 #include <string>
 #include <variant>
 #include <vector>
 
-#include "Environment.h"
+#include "Heap.h"
 #include "Interpreter.h"
 #include "LoxCallable.h"
 #include "LoxFunction.h"
 #include "LoxInstance.h"
-#include "Return.h"
-#include "Stmt.h"
-
-
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
+#include "Value.h"
 
 
 namespace lox {
 
 
 LoxFunction::LoxFunction(
-    const lox::stmt::Function& declaration,
-    const Environment& closure,
-    const bool& isInitializer)
-    : isInitializer(isInitializer),
-      closure(closure),
-      declaration(declaration) {}
-
-
-LoxFunction LoxFunction::bind(const LoxInstance& instance) {
-  Environment environment = new Environment(closure);
-  environment.define("this", instance);
-  return LoxFunction(declaration, environment, isInitializer);
+    const FunctionPrototype* prototype,
+    const Upvalues& upvalues)
+    : LoxCallable(ObjectType::OBJ_FUNCTION, prototype->arity),
+      prototype(prototype),
+      upvalues(upvalues),
+      receiver(nullptr) {}
+
+
+// binding shares the captured cells; the receiver becomes the method's
+// first local when it is called
+
+LoxFunction* LoxFunction::bind(LoxInstance* instance, Heap& heap) {
+  LoxFunction* method = heap.allocate<LoxFunction>(prototype, upvalues);
+  method->receiver = instance;
+  return method;
+}
+
+
+// the receiver and whatever the captured cells currently hold
+
+void LoxFunction::trace(Heap& heap) const {
+  heap.mark(receiver);
+
+  for (const auto& upvalue : upvalues) {
+    heap.mark(upvalue->get());
+  }
+}
+
+
+std::size_t LoxFunction::byteSize() const {
+  return sizeof(LoxFunction) + upvalues.capacity() * sizeof(upvalues[0]);
 }
 
 
-const std::string& LoxFunction::to_string() const {
-  return "<fn " + declaration.getName().getLexeme() + ">";
+std::string LoxFunction::to_string() const {
+  return "<fn " + prototype->name + ">";
 }
 
 
-int LoxFunction::arity() {
-  return declaration.params.size();
+Value LoxFunction::call(
+    const Interpreter& interpreter,
+    std::span<const Value> arguments) {
+  return LoxFunction::invoke(interpreter, receiver, arguments);
 }
 
 
-Object LoxFunction::call(
+// runs the body with the given receiver as its first local; a method called
+// straight from an invoke site gets its receiver this way instead of through
+// a bound copy
+//
+// A body that ends in a tail call leaves the call pending. Its frame is then
+// replaced by the callee's and the loop runs again, so a chain of tail calls
+// takes constant native stack.
+
+Value LoxFunction::invoke(
     const Interpreter& interpreter,
-    const std::vector<Object>& arguments) {
-  Environment environment = new Environment(closure);
+    const Value& receiver,
+    std::span<const Value> arguments) {
+  Interpreter& _interpreter = const_cast<Interpreter&>(interpreter);
+  TailCall& pending = _interpreter.getPendingTailCall();
+  // once the loop moves on, nothing else keeps the running function alive
+  TemporaryRoots roots(_interpreter.getHeap());
+
+  LoxFunction* function = this;
+  const FunctionPrototype* running = prototype;
+  Value self = receiver;
+  CallFrame previous =
+      _interpreter.pushFrame(running->declaration->getId(), &upvalues);
+  running->calls++;
+
+  if (!self.isNil()) {
+    _interpreter.define(running->receiver, self);
+  }
 
-  for (int i = 0; i < declaration.params.size(); i++) {
-    environment.define(
-        declaration.params[i].getLexeme(), arguments[i]);  // TODO
+  for (int i = 0; i < running->arity; i++) {
+    _interpreter.define(running->params[i], arguments[i]);
   }
 
-  try {
-    interpreter.executeBlock(declaration.getBody(), environment);
-  } catch (Return& returnValue) {
-    if (isInitializer) {
-      return closure.getAt(0, "this");
+  Completion completion;
+  while ((completion = _interpreter.executeBody(*running)) ==
+         Completion::TAIL_CALL) {
+    function = pending.callee.as<LoxFunction>();
+    running = function->prototype;
+    self = pending.receiver.isNil() ? function->receiver : pending.receiver;
+    roots.clear();
+    roots.push(function);
+    roots.push(self);
+
+    _interpreter.popFrame(previous);
+    _interpreter.pushFrame(running->declaration->getId(), &function->upvalues);
+    running->calls++;
+
+    if (!self.isNil()) {
+      _interpreter.define(running->receiver, self);
+    }
+
+    for (int i = 0; i < running->arity; i++) {
+      _interpreter.define(running->params[i], pending.arguments[i]);
     }
-    return returnValue.getValue();
+
+    pending.callee = nullptr;
+    pending.receiver = nullptr;
+    pending.arguments.clear();
+  }
+
+  Value result = nullptr;
+
+  if (completion == Completion::RETURN) {
+    result = _interpreter.takeReturnValue();
   }
 
-  if (isInitializer) {
-    closure.getAt(0, "this");
+  _interpreter.popFrame(previous);
+
+  if (running->isInitializer) {
+    return self;
   }
 
-  return nullptr;
+  return result;
 }
 
 
@@ -1,56 +1,56 @@
 #ifndef LOXFUNCTION_H
 #define LOXFUNCTION_H
 
+#include <span>
 #include <string>
-#include <variant>
 #include <vector>
 
-#include "Environment.h"
+#include "Heap.h"
 #include "Interpreter.h"
 #include "LoxCallable.h"
 #include "LoxInstance.h"
-#include "Stmt.h"
-
-
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
+#include "Value.h"
 
 
 namespace lox {
 
+// A closure: the prototype shared by every function made from the same
+// declaration, plus what this one captured.
+
 class LoxFunction : public LoxCallable {
  private:
-  lox::stmt::Function declaration;
-  Environment closure;
-  bool isInitializer;
+  const FunctionPrototype* prototype;
+  // exactly the cells the resolver found this function referring to
+  Upvalues upvalues;
+  Value receiver;
 
  public:
-  friend bool operator==(const LoxFunction& _x, const LoxFunction& _y) {
-    return _x == _y;
-  }
+  LoxFunction(const FunctionPrototype* prototype, const Upvalues& upvalues);
 
-  bool operator==(const std::nullptr_t& _y) const {
-    return *this == _y;
-  }
+  LoxFunction* bind(LoxInstance* instance, Heap& heap);
 
-  friend bool operator!=(const LoxFunction& _x, const LoxFunction& _y) {
-    return _x != _y;
+  const FunctionPrototype* getPrototype() const {
+    return prototype;
   }
 
-  bool operator!=(const std::nullptr_t& _y) const {
-    return !(*this == _y);
+  const Upvalues& getUpvalues() const {
+    return upvalues;
   }
 
-  LoxFunction(
-      const lox::stmt::Function& declaration,
-      const Environment& closure,
-      const bool& isInitializer);
+  const Value& getReceiver() const {
+    return receiver;
+  }
 
-  LoxFunction bind(const LoxInstance& instance);
-  const std::string& to_string() const;
-  int arity();
-  Object call(
+  void trace(Heap& heap) const;
+  std::size_t byteSize() const;
+  std::string to_string() const;
+  Value call(
+      const Interpreter& interpreter,
+      std::span<const Value> arguments);
+  Value invoke(
       const Interpreter& interpreter,
-      const std::vector<Object>& arguments);
+      const Value& receiver,
+      std::span<const Value> arguments);
 };
 
 }  // namespace lox
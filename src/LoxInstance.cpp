@@ -1,48 +1,110 @@
 #include <string>
-#include <variant>
 
+#include "Heap.h"
 #include "LoxClass.h"
 #include "LoxFunction.h"
 #include "LoxInstance.h"
 #include "RuntimeError.h"
 #include "Token.h"
-
-
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
+#include "Value.h"
 
 
 namespace lox {
 
-LoxInstance::LoxInstance(const auto& klass) : klass(klass) {}
+LoxInstance::LoxInstance(LoxClass* klass)
+    : LoxObject(ObjectType::OBJ_INSTANCE),
+      klass(klass),
+      shape(klass->getRootShape()) {}
 
 
-Object LoxInstance::get(const Token& name) {
-  if (fields.find(name.getLexeme()) != fields.end()) {
-    return fields[name.getLexeme()];
+Value LoxInstance::get(const Token& name, Heap& heap) {
+  int slot = shape->lookup(name.getLexeme());
+  if (slot != -1) {
+    return getField(slot);
   }
 
-  LoxFunction method = klass.findMethod(name.getLexeme());
+  LoxFunction* method = klass->findMethod(name.getLexeme());
 
   if (method != nullptr) {
-    return method.bind(*this);
+    return method->bind(this, heap);
+  }
+
+  throw RuntimeError(name, "Undefined property '" + name.getLexeme() + "'.");
+}
+
+
+// a new field moves the instance to the next shape and takes the slot after
+// the existing ones
+
+void LoxInstance::set(const Token& name, const Value& value, Heap& heap) {
+  int slot = shape->lookup(name.getLexeme());
+  if (slot == -1) {
+    addField(shape->transition(name.getLexeme()), value, heap);
+    return;
   }
 
-  throw new RuntimeError(
-      name, "Undefined property '" + name.getLexeme() + "'.");
+  setField(slot, value, heap);
+}
+
+
+Shape* LoxInstance::getShape() const {
+  return shape;
+}
+
+
+const Value& LoxInstance::getField(const int& slot) const {
+  if (slot < INLINE_FIELDS) {
+    return inlineFields[slot];
+  }
+  return extraFields[slot - INLINE_FIELDS];
+}
+
+
+void LoxInstance::setField(const int& slot, const Value& value, Heap& heap) {
+  heap.writeBarrier(this, value);
+
+  if (slot < INLINE_FIELDS) {
+    inlineFields[slot] = value;
+  } else {
+    extraFields[slot - INLINE_FIELDS] = value;
+  }
+}
+
+
+// moves to next, a child of the current shape, and stores the new field in
+// the slot it adds
+
+void LoxInstance::addField(Shape* next, const Value& value, Heap& heap) {
+  shape = next;
+  int slot = shape->size() - 1;
+  if (slot >= INLINE_FIELDS) {
+    extraFields.push_back(Value());
+  }
+
+  setField(slot, value, heap);
+}
+
+
+void LoxInstance::trace(Heap& heap) const {
+  heap.mark(klass);
+
+  for (int slot = 0; slot < shape->size(); slot++) {
+    heap.mark(getField(slot));
+  }
 }
 
 
-void LoxInstance::set(const Token& name, const Object& value) {
-  fields[name.getLexeme()] = value;
+std::size_t LoxInstance::byteSize() const {
+  return sizeof(LoxInstance) + extraFields.capacity() * sizeof(Value);
 }
 
 
-const std::string& LoxInstance::to_string() const {
-  return klass.getName() + " instance";
+std::string LoxInstance::to_string() const {
+  return klass->getName() + " instance";
 }
 
 
-const Object& LoxInstance::getKlass() const {
+LoxClass* LoxInstance::getKlass() const {
   return klass;
 }
 
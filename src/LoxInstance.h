@@ -1,15 +1,16 @@
 #ifndef LOXINSTANCE_H
 #define LOXINSTANCE_H
 
+#include <array>
 #include <string>
-#include <unordered_map>
-#include <variant>
+#include <vector>
 
+#include "Heap.h"
 #include "LoxClass.h"
+#include "LoxObject.h"
+#include "Shape.h"
 #include "Token.h"
-
-
-using Object = std::variant<std::nullptr_t, std::string, double, bool>;
+#include "Value.h"
 
 
 namespace lox {
@@ -17,18 +18,30 @@ namespace lox {
 class LoxClass;
 
 
-class LoxInstance {
+class LoxInstance : public LoxObject {
  private:
-  LoxClass klass;
-  std::unordered_map<std::string, Object> fields;
+  // the first fields live inside the object; the rest spill into a
+  // separately allocated array. Slot i holds the field the shape names at i.
+  static constexpr int INLINE_FIELDS = 4;
 
- public:
-  LoxInstance(const auto& klass);
+  LoxClass* klass;
+  Shape* shape;
+  std::array<Value, INLINE_FIELDS> inlineFields;
+  std::vector<Value> extraFields;
 
-  Object get(const Token& name);
-  void set(const Token& name, const Object& value);
-  const std::string& to_string() const;
-  const Object& getKlass() const;
+ public:
+  LoxInstance(LoxClass* klass);
+
+  Value get(const Token& name, Heap& heap);
+  void set(const Token& name, const Value& value, Heap& heap);
+  Shape* getShape() const;
+  const Value& getField(const int& slot) const;
+  void setField(const int& slot, const Value& value, Heap& heap);
+  void addField(Shape* next, const Value& value, Heap& heap);
+  void trace(Heap& heap) const;
+  std::size_t byteSize() const;
+  std::string to_string() const;
+  LoxClass* getKlass() const;
 };
 
 
@@ -0,0 +1,57 @@
+#ifndef LOXOBJECT_H
+#define LOXOBJECT_H
+
+#include <cstddef>
+#include <string>
+
+
+namespace lox {
+
+enum ObjectType {
+  OBJ_STRING,
+  OBJ_FUNCTION,
+  OBJ_CLASS,
+  OBJ_INSTANCE,
+};
+
+
+class Heap;
+
+
+// Base of everything a Value can point to. The heap links every object it
+// hands out into its generation's list, and the collector walks those lists
+// to free unmarked objects.
+
+class LoxObject {
+ private:
+  ObjectType type;
+  bool marked = false;
+  // survived a collection and now lives in the old generation
+  bool old = false;
+  // old object already queued in the remembered set
+  bool remembered = false;
+  LoxObject* next = nullptr;
+
+  friend class Heap;
+
+ public:
+  LoxObject(const ObjectType& type) : type(type) {}
+  virtual ~LoxObject() = default;
+
+  const ObjectType& getType() const {
+    return type;
+  }
+
+  // mark every object this one refers to
+  virtual void trace(Heap& heap) const {}
+
+  // approximate memory owned by the object, for the collector's accounting
+  virtual std::size_t byteSize() const = 0;
+
+  virtual std::string to_string() const = 0;
+};
+
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,72 @@
+#include <cstdint>
+#include <string>
+#include <utility>
+
+#include "LoxObject.h"
+#include "LoxString.h"
+
+
+namespace lox {
+
+LoxString::LoxString(const std::string& chars)
+    : LoxObject(ObjectType::OBJ_STRING), chars(chars), hash(hashString(chars)) {}
+
+
+LoxString::LoxString(std::string&& chars)
+    : LoxObject(ObjectType::OBJ_STRING),
+      chars(std::move(chars)),
+      hash(hashString(this->chars)) {}
+
+
+// FNV-1a
+
+std::uint32_t LoxString::hashString(const std::string& chars) {
+  std::uint32_t hash = 2166136261u;
+
+  for (const char& c : chars) {
+    hash ^= static_cast<std::uint8_t>(c);
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+
+const std::string& LoxString::getChars() const {
+  return chars;
+}
+
+
+std::size_t LoxString::length() const {
+  return chars.size();
+}
+
+
+std::uint32_t LoxString::getHash() const {
+  return hash;
+}
+
+
+bool LoxString::equals(const LoxString& other) const {
+  if (this == &other) {
+    return true;
+  }
+
+  if (hash != other.hash || chars.size() != other.chars.size()) {
+    return false;
+  }
+
+  return chars == other.chars;
+}
+
+
+std::size_t LoxString::byteSize() const {
+  return sizeof(LoxString) + chars.capacity();
+}
+
+
+std::string LoxString::to_string() const {
+  return chars;
+}
+
+}  // namespace lox
@@ -0,0 +1,39 @@
+#ifndef LOXSTRING_H
+#define LOXSTRING_H
+
+#include <cstdint>
+#include <string>
+
+#include "LoxObject.h"
+
+
+namespace lox {
+
+// An immutable string on the heap. Values refer to it by pointer, so copying
+// a string value never copies its characters. The hash is computed once at
+// construction, which lets equality reject most mismatches without looking
+// at the characters.
+
+class LoxString : public LoxObject {
+ private:
+  const std::string chars;
+  const std::uint32_t hash;
+
+  static std::uint32_t hashString(const std::string& chars);
+
+ public:
+  LoxString(const std::string& chars);
+  LoxString(std::string&& chars);
+
+  const std::string& getChars() const;
+  std::size_t length() const;
+  std::uint32_t getHash() const;
+  bool equals(const LoxString& other) const;
+  std::size_t byteSize() const;
+  std::string to_string() const;
+};
+
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,99 @@
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <string_view>
+
+#include "Output.h"
+
+
+namespace lox {
+
+// a terminal sees each line as it is printed; a pipe or a file gets full
+// buffers
+
+Output::Output(const int& fd)
+    : fd(fd),
+      policy(isatty(fd) ? FlushPolicy::LINE : FlushPolicy::SIZE),
+      buffer(CAPACITY) {}
+
+
+Output::~Output() {
+  Output::flush();
+}
+
+
+void Output::write(std::string_view text) {
+  if (text.size() <= buffer.size() - used) {
+    std::memcpy(buffer.data() + used, text.data(), text.size());
+    used += text.size();
+    return;
+  }
+
+  if (policy == FlushPolicy::EXIT) {
+    buffer.resize(std::max(buffer.size() * 2, used + text.size()));
+    std::memcpy(buffer.data() + used, text.data(), text.size());
+    used += text.size();
+    return;
+  }
+
+  struct iovec parts[2] = {
+      {buffer.data(), used},
+      {const_cast<char*>(text.data()), text.size()}};
+  Output::writeAll(parts, 2);
+  used = 0;
+}
+
+
+void Output::endLine() {
+  Output::write("\n");
+
+  if (policy == FlushPolicy::LINE) {
+    Output::flush();
+  }
+}
+
+
+void Output::flush() {
+  if (used == 0) {
+    return;
+  }
+
+  struct iovec part = {buffer.data(), used};
+  Output::writeAll(&part, 1);
+  used = 0;
+}
+
+
+// writev may stop part way through; carry on from where it stopped
+
+void Output::writeAll(struct iovec* parts, int count) {
+  while (count > 0) {
+    ssize_t written = ::writev(fd, parts, count);
+
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // there is nowhere left to report a closed stdout to
+      return;
+    }
+
+    while (count > 0 && static_cast<std::size_t>(written) >= parts->iov_len) {
+      written -= parts->iov_len;
+      parts++;
+      count--;
+    }
+
+    if (count > 0) {
+      parts->iov_base = static_cast<char*>(parts->iov_base) + written;
+      parts->iov_len -= written;
+    }
+  }
+}
+
+
+}  // namespace lox
@@ -0,0 +1,61 @@
+#ifndef OUTPUT_H
+#define OUTPUT_H
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+
+struct iovec;
+
+
+namespace lox {
+
+// when buffered output is handed to the operating system
+
+enum class FlushPolicy {
+  // after every line, as a terminal expects
+  LINE,
+  // whenever the buffer fills
+  SIZE,
+  // only at exit, or before a diagnostic goes to stderr
+  EXIT,
+};
+
+
+// Collects what a script prints in a user-space buffer and writes it to a
+// file descriptor in large batches. Text that does not fit in the space left
+// goes out together with the buffer in a single writev, so it is not copied
+// first. Anything about to write to stderr flushes this first, so the two
+// streams keep the order the script produced them in.
+
+class Output {
+ private:
+  static constexpr std::size_t CAPACITY = 64 * 1024;
+
+  int fd;
+  FlushPolicy policy;
+  std::vector<char> buffer;
+  std::size_t used = 0;
+
+  void writeAll(struct iovec* parts, int count);
+
+ public:
+  Output(const int& fd = 1);
+  ~Output();
+
+  Output(const Output&) = delete;
+  Output& operator=(const Output&) = delete;
+
+  void setPolicy(const FlushPolicy& selected) {
+    policy = selected;
+  }
+
+  void write(std::string_view text);
+  void endLine();
+  void flush();
+};
+
+
+}  // namespace lox
+
+#endif
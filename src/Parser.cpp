@@ -1,3 +1,5 @@
+#include <string>
+#include <variant>
 #include <vector>
 
 #include "Expr.h"
@@ -13,14 +15,15 @@ namespace parser {
 
 // input: sequence of tokens
 
-Parser::Parser(const std::vector<Token>& tokens) : tokens(tokens) {}
+Parser::Parser(lox::Script& script, const int& firstId)
+    : script(script), tokens(script.tokens), nodeCount(firstId) {}
 
 
 std::vector<lox::stmt::Stmt> Parser::parseStmt() {
   std::vector<lox::stmt::Stmt> statements;
 
   while (!Parser::isAtEnd()) {
-    statements.push_back(Parser::statement());
+    statements.push_back(Parser::declaration());
   }
   return statements;
 }
@@ -48,7 +51,7 @@ lox::stmt::Stmt Parser::statement() {
   }
 
   if (Parser::match(TokenType::LEFT_BRACE)) {
-    return lox::stmt::Block(Parser::block());
+    return Parser::tag(lox::stmt::Block(Parser::block()));
   }
 
   return Parser::expressionStatement();
@@ -91,20 +94,22 @@ lox::stmt::Stmt Parser::forStatement() {
 
   if (increment != nullptr) {
     std::vector<lox::stmt::Stmt> _stmt;
-    _stmt.push_back(lox::stmt::Expression(increment));
-    body = lox::stmt::Block(_stmt);
+    _stmt.push_back(body);
+    _stmt.push_back(Parser::tag(lox::stmt::Expression(increment)));
+    body = Parser::tag(lox::stmt::Block(_stmt));
   }
 
   if (condition == nullptr) {
-    condition = lox::expr::Literal(true);
+    condition = Parser::tag(lox::expr::Literal(true));
   }
 
-  body = lox::stmt::While(condition, body);
+  body = Parser::tag(lox::stmt::While(condition, body));
 
   if (initializer != nullptr) {
     std::vector<lox::stmt::Stmt> _stmt;
+    _stmt.push_back(initializer);
     _stmt.push_back(body);
-    body = lox::stmt::Block(_stmt);
+    body = Parser::tag(lox::stmt::Block(_stmt));
   }
 
   return body;
@@ -127,11 +132,7 @@ lox::stmt::Stmt Parser::ifStatement() {
     elseBranch = Parser::statement();
   }
 
-  // TODO: remove this
-  const lox::stmt::Stmt* _thenBranch = &thenBranch;
-  const lox::stmt::Stmt* _elseBranch = &elseBranch;
-
-  return lox::stmt::If(condition, _thenBranch, _elseBranch);
+  return Parser::tag(lox::stmt::If(condition, thenBranch, elseBranch));
 }
 
 
@@ -140,14 +141,14 @@ lox::stmt::Stmt Parser::ifStatement() {
 lox::stmt::Stmt Parser::printStatement() {
   lox::expr::Expr value = Parser::expression();
   Parser::consume(TokenType::SEMICOLON, "Expect ';' after value.");
-  return lox::stmt::Print(value);
+  return Parser::tag(lox::stmt::Print(value));
 }
 
 
 // return stmt
 
 lox::stmt::Stmt Parser::returnStatement() {
-  Token keyword = Parser::previous();
+  const Token& keyword = Parser::previous();
   lox::expr::Expr value;
   value = nullptr;
 
@@ -157,14 +158,15 @@ lox::stmt::Stmt Parser::returnStatement() {
 
   Parser::consume(TokenType::SEMICOLON, "Expect ';' after return value.");
 
-  return lox::stmt::Return(keyword, value);
+  return Parser::tag(lox::stmt::Return(keyword, value));
 }
 
 
 // var declaration
 
 lox::stmt::Stmt Parser::varDeclaration() {
-  Token name = Parser::consume(TokenType::IDENTIFIER, "Expect variable name.");
+  const Token& name =
+      Parser::consume(TokenType::IDENTIFIER, "Expect variable name.");
 
   lox::expr::Expr initializer;
   initializer = nullptr;
@@ -175,7 +177,7 @@ lox::stmt::Stmt Parser::varDeclaration() {
   Parser::consume(
       TokenType::SEMICOLON, "Expect ';' after variable declaration.");
 
-  return lox::stmt::Var(name, initializer);
+  return Parser::tag(lox::stmt::Var(name, initializer));
 }
 
 
@@ -188,7 +190,7 @@ lox::stmt::Stmt Parser::whileStatement() {
   Parser::consume(TokenType::RIGHT_PAREN, "Expect ')' after condition.");
   lox::stmt::Stmt body = Parser::statement();
 
-  return lox::stmt::While(condition, body);
+  return Parser::tag(lox::stmt::While(condition, body));
 }
 
 
@@ -197,36 +199,7 @@ lox::stmt::Stmt Parser::whileStatement() {
 lox::stmt::Stmt Parser::expressionStatement() {
   lox::expr::Expr _expr = Parser::expression();
   Parser::consume(TokenType::SEMICOLON, "Expect ';' after expression.");
-  return lox::stmt::Expression(_expr);
-}
-
-
-lox::stmt::Function function(const std::string& kind) {
-  Parser _parser;
-  Token name =
-      _parser.consume(TokenType::IDENTIFIER, "Expect " + kind + " name.");
-
-  _parser.consume(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.");
-
-  std::vector<Token> parameters;
-  if (!_parser.check(TokenType::RIGHT_PAREN)) {
-    do {
-      if (parameters.size() >= 255) {
-        ParseError error(
-            _parser.peek(), "Can't have more than 255 parameters.");
-      }
-
-      parameters.push_back(
-          _parser.consume(TokenType::IDENTIFIER, "Expect parameter name."));
-    } while (_parser.match(TokenType::COMMA));
-  }
-
-  _parser.consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
-  _parser.consume(
-      TokenType::LEFT_BRACE, "Expect '{' before " + kind + " body.");
-  std::vector<lox::stmt::Stmt> body = _parser.block();
-
-  return lox::stmt::Function(name, parameters, body);
+  return Parser::tag(lox::stmt::Expression(_expr));
 }
 
 
@@ -234,19 +207,21 @@ std::vector<lox::stmt::Stmt> Parser::block() {
   std::vector<lox::stmt::Stmt> statements;
 
   while (!Parser::check(TokenType::RIGHT_BRACE) && !Parser::isAtEnd()) {
-    // statements.push_back(Parser::declaration());
+    statements.push_back(Parser::declaration());
   }
 
   Parser::consume(TokenType::RIGHT_BRACE, "Expect '}' after block.");
   return statements;
 }
 
-/*
+
+// declarations
+
 lox::stmt::Stmt Parser::declaration() {
   try {
-    //if (Parser::match(TokenType::CLASS)) {
-    //  return Parser::classDeclaration();
-    //}
+    if (Parser::match(TokenType::CLASS)) {
+      return Parser::classDeclaration();
+    }
 
     if (Parser::match(TokenType::FUN)) {
       return Parser::function("function");
@@ -258,7 +233,7 @@ lox::stmt::Stmt Parser::declaration() {
 
     return Parser::statement();
 
-  } catch (ParseError error) {
+  } catch (const ParseError& error) {
     Parser::synchronize();
     return lox::stmt::Stmt();
   }
@@ -266,13 +241,17 @@ lox::stmt::Stmt Parser::declaration() {
 
 
 lox::stmt::Stmt Parser::classDeclaration() {
-  Token name = Parser::consume(TokenType::IDENTIFIER, "Expect class name.");
+  const Token& name =
+      Parser::consume(TokenType::IDENTIFIER, "Expect class name.");
 
-  lox::expr::Variable superclass(Token());
-  if (Parser::match(TokenType::LESS)) {
+  // without a superclass the variable keeps no ID, which marks it absent
+  bool inherits = Parser::match(TokenType::LESS);
+  if (inherits) {
     Parser::consume(TokenType::IDENTIFIER, "Expect superclass name.");
-    superclass = lox::expr::Variable(Parser::previous());
   }
+  lox::expr::Variable superclass = inherits
+      ? Parser::tag(lox::expr::Variable(Parser::previous()))
+      : lox::expr::Variable(name);
 
   Parser::consume(TokenType::LEFT_BRACE, "Expect '{' before class body.");
 
@@ -283,16 +262,53 @@ lox::stmt::Stmt Parser::classDeclaration() {
 
   Parser::consume(TokenType::RIGHT_BRACE, "Expect '}' after class body.");
 
-  return lox::stmt::Class(name, superclass, methods);
+  lox::stmt::Class declaration =
+      Parser::tag(lox::stmt::Class(name, superclass, methods));
+  Parser::reserve(1);
+
+  return declaration;
 }
-*/
+
+
+// function and method declarations
+
+lox::stmt::Function Parser::function(const std::string& kind) {
+  const Token& name =
+      Parser::consume(TokenType::IDENTIFIER, "Expect " + kind + " name.");
+
+  Parser::consume(TokenType::LEFT_PAREN, "Expect '(' after " + kind + " name.");
+
+  std::vector<Token> parameters;
+  if (!Parser::check(TokenType::RIGHT_PAREN)) {
+    do {
+      if (parameters.size() >= 255) {
+        Parser::error(Parser::peek(), "Can't have more than 255 parameters.");
+      }
+
+      parameters.push_back(
+          Parser::consume(TokenType::IDENTIFIER, "Expect parameter name."));
+    } while (Parser::match(TokenType::COMMA));
+  }
+
+  Parser::consume(TokenType::RIGHT_PAREN, "Expect ')' after parameters.");
+  Parser::consume(
+      TokenType::LEFT_BRACE, "Expect '{' before " + kind + " body.");
+  std::vector<lox::stmt::Stmt> body = Parser::block();
+
+  lox::stmt::Function declaration =
+      Parser::tag(lox::stmt::Function(name, parameters, body));
+  Parser::reserve(parameters.size());
+
+  return declaration;
+}
+
 
 // below are the rules, converting themselves to the tree structure
 
 lox::expr::Expr Parser::parse() {
   try {
     return Parser::expression();
-  } catch (ParseError error) {
+  } catch (const ParseError& error) {
     // returns NULL because we want to take this to the interpreter
     return lox::expr::Expr();
   }
@@ -301,7 +317,7 @@ lox::expr::Expr Parser::parse() {
 
 lox::expr::Expr Parser::expression() {
   // for parsing expressions
-  return Parser::equality();
+  return Parser::assignment();
 }
 
 
@@ -309,9 +325,9 @@ lox::expr::Expr Parser::equality() {
   lox::expr::Expr expr = Parser::comparison();
 
   while (Parser::match(TokenType::BANG_EQUAL, TokenType::EQUAL_EQUAL)) {
-    Token op = Parser::previous();
+    const Token& op = Parser::previous();
     lox::expr::Expr right = Parser::comparison();
-    expr = lox::expr::Binary(expr, op, right);
+    expr = Parser::tag(lox::expr::Binary(expr, op, right));
   }
 
   return expr;
@@ -323,38 +339,41 @@ bool instanceof (const T& ptr) {
   return dynamic_cast<const base*>(&ptr) != nullptr;
 }
 
-/*
+// a handle is only an Expr; which class it was made as is on the node the
+// script owns
+
 lox::expr::Expr Parser::assignment() {
   lox::expr::Expr _expr = Parser::_or();
 
   if (Parser::match(TokenType::EQUAL)) {
-    Token equals = Parser::previous();
+    const Token& equals = Parser::previous();
     lox::expr::Expr value = Parser::assignment();
 
-    if (instanceof <lox::expr::Variable>(_expr)) {
-      lox::expr::Variable& variable = static_cast<lox::expr::Variable>(_expr);
-      Token name = variable.getName();
-      return lox::expr::Assign(name, value);
+    if (instanceof <lox::expr::Variable>(_expr.getNode())) {
+      const lox::expr::Variable& variable =
+          static_cast<const lox::expr::Variable&>(_expr.getNode());
+      return Parser::tag(lox::expr::Assign(variable.getName(), value));
 
-    } else if (instanceof <lox::expr::Get>(_expr)) {
-      lox::expr::Get get = static_cast<lox::expr::Get>(_expr);
-      return lox::expr::Set(get.getObject(), get.getName(), value);
+    } else if (instanceof <lox::expr::Get>(_expr.getNode())) {
+      const lox::expr::Get& get =
+          static_cast<const lox::expr::Get&>(_expr.getNode());
+      return Parser::tag(
+          lox::expr::Set(get.getObject(), get.getName(), value));
     }
 
-    ParseError error(equals, "Invalid assignment target.");
+    Parser::error(equals, "Invalid assignment target.");
   }
 
   return _expr;
 }
-*/
 
 lox::expr::Expr Parser::_or() {
   lox::expr::Expr _expr = Parser::_and();
 
   while (Parser::match(TokenType::OR)) {
-    Token op = Parser::previous();
+    const Token& op = Parser::previous();
     lox::expr::Expr right = Parser::_and();
-    _expr = lox::expr::Logical(_expr, op, right);  // TODO: new?
+    _expr = Parser::tag(lox::expr::Logical(_expr, op, right));  // TODO: new?
   }
 
   return _expr;
@@ -365,33 +384,15 @@ lox::expr::Expr Parser::_and() {
   lox::expr::Expr _expr = Parser::equality();
 
   while (Parser::match(TokenType::AND)) {
-    Token op = Parser::previous();
+    const Token& op = Parser::previous();
     lox::expr::Expr right = Parser::equality();
-    _expr = lox::expr::Logical(_expr, op, right);
+    _expr = Parser::tag(lox::expr::Logical(_expr, op, right));
   }
 
   return _expr;
 }
 
 
-bool Parser::match(const TokenType& types, ...) {
-  va_list args;
-  va_start(args, types);
-
-  for (TokenType type = types; type != TokenType::_EOF;
-       type = va_arg(args, TokenType)) {
-    if (Parser::check(type)) {
-      Parser::advance();
-      va_end(args);
-      return true;
-    }
-  }
-
-  va_end(args);
-  return false;
-}
-
-
 bool Parser::check(const TokenType& type) {
   if (Parser::isAtEnd()) {
     return false;
@@ -400,7 +401,7 @@ bool Parser::check(const TokenType& type) {
 }
 
 
-Token Parser::advance() {
+const Token& Parser::advance() {
   if (!Parser::isAtEnd()) {
     current++;
   }
@@ -413,12 +414,12 @@ bool Parser::isAtEnd() {
 }
 
 
-Token Parser::peek() {
+const Token& Parser::peek() {
   return tokens[current];
 }
 
 
-Token Parser::previous() {
+const Token& Parser::previous() {
   return tokens[current - 1];
 }
 
@@ -431,9 +432,9 @@ lox::expr::Expr Parser::comparison() {
       TokenType::GREATER_EQUAL,
       TokenType::LESS,
       TokenType::LESS_EQUAL)) {
-    Token op = Parser::previous();
+    const Token& op = Parser::previous();
     lox::expr::Expr right = Parser::term();
-    expr = lox::expr::Binary(expr, op, right);
+    expr = Parser::tag(lox::expr::Binary(expr, op, right));
   }
 
   return expr;
@@ -444,9 +445,9 @@ lox::expr::Expr Parser::term() {
   lox::expr::Expr expr = Parser::factor();
 
   while (Parser::match(TokenType::MINUS, TokenType::PLUS)) {
-    Token op = Parser::previous();
+    const Token& op = Parser::previous();
     lox::expr::Expr right = Parser::factor();
-    expr = lox::expr::Binary(expr, op, right);
+    expr = Parser::tag(lox::expr::Binary(expr, op, right));
   }
 
   return expr;
@@ -457,9 +458,9 @@ lox::expr::Expr Parser::factor() {
   lox::expr::Expr expr = Parser::unary();
 
   while (Parser::match(TokenType::SLASH, TokenType::STAR)) {
-    Token op = Parser::previous();
+    const Token& op = Parser::previous();
     lox::expr::Expr right = Parser::unary();
-    expr = lox::expr::Binary(expr, op, right);
+    expr = Parser::tag(lox::expr::Binary(expr, op, right));
   }
 
   return expr;
@@ -468,9 +469,9 @@ lox::expr::Expr Parser::factor() {
 
 lox::expr::Expr Parser::unary() {
   if (Parser::match(TokenType::BANG, TokenType::MINUS)) {
-    Token op = Parser::previous();
+    const Token& op = Parser::previous();
     lox::expr::Expr right = Parser::unary();
-    return lox::expr::Unary(op, right);
+    return Parser::tag(lox::expr::Unary(op, right));
   }
 
   // return Parser::primary();
@@ -484,17 +485,17 @@ lox::expr::Expr Parser::finishCall(const lox::expr::Expr& callee) {
   if (!Parser::check(TokenType::RIGHT_PAREN)) {
     do {
       if (arguments.size() >= 255) {
-        ParseError error(Parser::peek(), "Can't have more than 255 arguments.");
+        Parser::error(Parser::peek(), "Can't have more than 255 arguments.");
       }
 
       arguments.push_back(Parser::expression());
     } while (Parser::match(TokenType::COMMA));
   }
 
-  Token paren =
+  const Token& paren =
       Parser::consume(TokenType::RIGHT_PAREN, "Expect ')' after arguments.");
 
-  return lox::expr::Call(callee, paren, arguments);
+  return Parser::tag(lox::expr::Call(callee, paren, arguments));
 }
 
 
@@ -506,9 +507,9 @@ lox::expr::Expr Parser::call() {
       _expr = Parser::finishCall(_expr);
 
     } else if (Parser::match(TokenType::DOT)) {
-      Token name = Parser::consume(
+      const Token& name = Parser::consume(
           TokenType::IDENTIFIER, "Expect property name after '.'.");
-      _expr = lox::expr::Get(_expr, name);
+      _expr = Parser::tag(lox::expr::Get(_expr, name));
     } else {
       break;
     }
@@ -519,62 +520,75 @@ lox::expr::Expr Parser::call() {
 
 lox::expr::Expr Parser::primary() {
   if (Parser::match(TokenType::FALSE)) {
-    return lox::expr::Literal(false);
+    return Parser::tag(lox::expr::Literal(false));
   }
 
   if (Parser::match(TokenType::TRUE)) {
-    return lox::expr::Literal(true);
+    return Parser::tag(lox::expr::Literal(true));
   }
 
   if (Parser::match(TokenType::NIL)) {
-    return lox::expr::Literal(nullptr);
+    return Parser::tag(lox::expr::Literal(nullptr));
   }
 
-  if (Parser::match(TokenType::NUMBER, TokenType::STRING)) {
-    return lox::expr::Literal(Parser::previous().getLiteral());
+  if (Parser::match(TokenType::NUMBER)) {
+    return Parser::tag(lox::expr::Literal(
+        std::get<double>(Parser::previous().getLiteral())));
+  }
+
+  if (Parser::match(TokenType::STRING)) {
+    return Parser::tag(lox::expr::Literal(Parser::previous()));
   }
 
   if (Parser::match(TokenType::SUPER)) {
-    Token keyword = Parser::previous();
+    const Token& keyword = Parser::previous();
     Parser::consume(TokenType::DOT, "Expect '.' after 'super'.");
-    Token method = Parser::consume(
+    const Token& method = Parser::consume(
         TokenType::IDENTIFIER, "Expect superclass method name.");
     // don't use "new" keyword
-    return lox::expr::Super(keyword, method);
+    lox::expr::Super _expr = Parser::tag(lox::expr::Super(keyword, method));
+    Parser::reserve(1);
+    return _expr;
   }
 
   if (Parser::match(TokenType::THIS)) {
-    return lox::expr::This(Parser::previous());
+    return Parser::tag(lox::expr::This(Parser::previous()));
   }
 
   if (Parser::match(TokenType::IDENTIFIER)) {
-    return lox::expr::Variable(Parser::previous());
+    return Parser::tag(lox::expr::Variable(Parser::previous()));
   }
 
   if (Parser::match(TokenType::LEFT_PAREN)) {
     lox::expr::Expr expr = Parser::expression();
     Parser::consume(TokenType::RIGHT_PAREN, "Expect ')' after expression.");
-    return lox::expr::Grouping(expr);
+    return Parser::tag(lox::expr::Grouping(expr));
   }
 
-  throw ParseError(Parser::peek(), "Expect expression.");
+  throw Parser::error(Parser::peek(), "Expect expression.");
 }
 
 
 // entering panic mode
 
-Token Parser::consume(const TokenType& type, const std::string& message) {
+const Token& Parser::consume(
+    const TokenType& type,
+    const std::string& message) {
   if (Parser::check(type)) {
     return Parser::advance();
   }
 
-  throw ParseError(Parser::peek(), message);
+  throw Parser::error(Parser::peek(), message);
 }
 
 
-lox::parser::ParseError error(const Token& token, const std::string& message) {
-  // Lox::error(token, message);
-  return lox::parser::ParseError(token, message);
+// reports the error and hands it back, for the caller to throw when it has
+// to unwind
+
+ParseError Parser::error(const Token& token, const std::string& message) {
+  Lox _lox;
+  _lox.error(token, message);
+  return ParseError(token, message);
 }
 
 
@@ -597,6 +611,8 @@ void Parser::synchronize() {
       case PRINT:
       case RETURN:
         return;
+      default:
+        break;
     }
     Parser::advance();
   }
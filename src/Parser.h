@@ -3,13 +3,15 @@
 #ifndef PARSER_H
 #define PARSER_H
 
-#include <stdarg.h>
+#include <memory>
 #include <stdexcept>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 #include "Expr.h"
 #include "Lox.h"
+#include "Script.h"
 #include "Stmt.h"
 #include "Token.h"
 #include "TokenType.h"
@@ -26,46 +28,86 @@ class ParseError : public std::runtime_error {
       : std::runtime_error(message), token(token) {}
 
   const Token& token;
-  ParseError error(const Token& token, const std::string& message);
 };
 
 
 class Parser {
  private:
-  std::vector<Token> tokens;
+  lox::Script& script;
+  const std::vector<Token>& tokens;
   int current = 0;
+  int nodeCount = 0;
 
  public:
-  Parser() {}
-  Parser(const std::vector<Token>& tokens);
+  // IDs start at firstId, so trees parsed one after another never share one
+  Parser(lox::Script& script, const int& firstId = 0);
+
+  // every node gets a dense ID so later passes can keep their results in
+  // flat side tables instead of maps keyed on the node itself. The script
+  // keeps the node; the parser goes on with a copy that refers back to it.
+  template <class T>
+  T tag(T node) {
+    auto owned = std::make_unique<T>(node);
+    owned->setId(nodeCount++);
+    T copy = *owned;
+
+    if constexpr (std::is_base_of_v<lox::expr::Expr, T>) {
+      script.exprs.push_back(std::move(owned));
+    } else {
+      script.stmts.push_back(std::move(owned));
+    }
+    return copy;
+  }
+
+  // reserves IDs for declarations that are not nodes, e.g. parameters
+  void reserve(const int& count) {
+    nodeCount += count;
+  }
+
+  const int& getNodeCount() const {
+    return nodeCount;
+  }
 
   std::vector<lox::stmt::Stmt> parseStmt();
   lox::stmt::Stmt statement();
   lox::stmt::Stmt printStatement();
   lox::stmt::Stmt expressionStatement();
-  // lox::stmt::Stmt declaration();
-  // lox::stmt::Stmt classDeclaration();
+  lox::stmt::Stmt declaration();
+  lox::stmt::Stmt classDeclaration();
   lox::stmt::Stmt forStatement();
   lox::stmt::Stmt ifStatement();
   lox::stmt::Stmt returnStatement();
   lox::stmt::Stmt varDeclaration();
   lox::stmt::Stmt whileStatement();
-  // lox::stmt::Stmt function(const std::string& kind);
+  lox::stmt::Function function(const std::string& kind);
   std::vector<lox::stmt::Stmt> block();
 
   lox::expr::Expr parse();
-  // lox::expr::Expr assignment();
+  lox::expr::Expr assignment();
   lox::expr::Expr _or();
   lox::expr::Expr _and();
   lox::expr::Expr expression();
   lox::expr::Expr equality();
-  bool match(const TokenType& types, ...);
-  Token consume(const TokenType& type, const std::string& message);
+
+  // advances past the next token if it is any of the given types
+  template <class... Types>
+  bool match(const Types&... types) {
+    for (const TokenType& type : {types...}) {
+      if (Parser::check(type)) {
+        Parser::advance();
+        return true;
+      }
+    }
+    return false;
+  }
+
+  const Token& consume(const TokenType& type, const std::string& message);
+  ParseError error(const Token& token, const std::string& message);
   bool check(const TokenType& type);
-  Token advance();
+  const Token& advance();
   bool isAtEnd();
-  Token peek();
-  Token previous();
+  const Token& peek();
+  const Token& previous();
   lox::expr::Expr comparison();
   lox::expr::Expr term();
   lox::expr::Expr factor();
@@ -1,5 +1,6 @@
+#include <algorithm>
+#include <cstddef>
 #include <deque>
-#include <stack>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -7,6 +8,7 @@
 #include "Expr.h"
 #include "Interpreter.h"
 #include "Lox.h"
+#include "LoxString.h"
 #include "Resolver.h"
 #include "Stmt.h"
 
@@ -14,19 +16,26 @@
 namespace lox {
 
 Resolver::Resolver(const lox::Interpreter& interpreter)
-    : interpreter(interpreter) {}
+    : interpreter(interpreter) {
+  // frame for locals of blocks at the top level of the script
+  frames.push_back(FrameInfo{-1});
+}
 
 
 void lox::Resolver::resolve(const std::vector<lox::stmt::Stmt>& statements) {
-  for (lox::stmt::Stmt statement : statements) {
+  for (const lox::stmt::Stmt& statement : statements) {
     lox::Resolver::resolve(statement);
   }
 }
 
 
 // block stmt
+//
+// A block's locals are slots and cells of the enclosing function's frame, so
+// every block can run as part of the statement list around it.
 
 void lox::Resolver::visitBlockStmt(const lox::stmt::Block& _stmt) {
+  getInterpreter().resolveBlock(_stmt.getId(), _stmt);
   lox::Resolver::beginScope();
   lox::Resolver::resolve(_stmt.getStatements());
   lox::Resolver::endScope();
@@ -40,7 +49,7 @@ void lox::Resolver::visitClassStmt(const lox::stmt::Class& _stmt) {
   ClassType enclosingClass = currentClass;
   currentClass = ClassType::_CLASS;
 
-  lox::Resolver::declare(_stmt.getName());
+  lox::Resolver::declare(_stmt.getName(), _stmt.getId());
   lox::Resolver::define(_stmt.getName());
 
   if (_stmt.getSuperclass() != nullptr &&
@@ -56,15 +65,15 @@ void lox::Resolver::visitClassStmt(const lox::stmt::Class& _stmt) {
     lox::Resolver::resolve(_stmt.getSuperclass());
   }
 
+  // methods capture "super" from this scope like any other local; "this" is
+  // declared by each method itself
+
   if (_stmt.getSuperclass() != nullptr) {
     lox::Resolver::beginScope();
-    scopes.top()["super"] = true;
+    lox::Resolver::declare("super", _stmt.getSuperId());
   }
 
-  lox::Resolver::beginScope();
-  scopes.top()["this"] = true;
-
-  for (typename lox::stmt::Function method : _stmt.getMethods()) {
+  for (const lox::stmt::Function& method : _stmt.getMethods()) {
     FunctionType declaration = FunctionType::METHOD;
 
     if (method.getName().getLexeme() == "init") {
@@ -73,8 +82,6 @@ void lox::Resolver::visitClassStmt(const lox::stmt::Class& _stmt) {
     lox::Resolver::resolveFunction(method, declaration);
   }
 
-  lox::Resolver::endScope();
-
   if (_stmt.getSuperclass() != nullptr) {
     lox::Resolver::endScope();
   }
@@ -95,7 +102,7 @@ void lox::Resolver::visitExpressionStmt(const lox::stmt::Expression& _stmt) {
 // function stmt
 
 void lox::Resolver::visitFunctionStmt(const lox::stmt::Function& _stmt) {
-  lox::Resolver::declare(_stmt.getName());
+  lox::Resolver::declare(_stmt.getName(), _stmt.getId());
   lox::Resolver::define(_stmt.getName());
 
   lox::Resolver::resolveFunction(_stmt, FunctionType::FUNCTION);
@@ -140,6 +147,11 @@ void lox::Resolver::visitReturnStmt(const lox::stmt::Return& _stmt) {
           _stmt.getKeyword(), "Can't return a value from an initializer.");
     }
     lox::Resolver::resolve(_stmt.getValue());
+
+    // the call is made in place of the returning function's frame
+    if (const lox::expr::Call* call = calls[_stmt.getValue().getId()]) {
+      getInterpreter().resolveTailCall(_stmt.getId(), *call);
+    }
   }
 
   return;
@@ -149,7 +161,7 @@ void lox::Resolver::visitReturnStmt(const lox::stmt::Return& _stmt) {
 // var stmt
 
 void lox::Resolver::visitVarStmt(const lox::stmt::Var& _stmt) {
-  lox::Resolver::declare(_stmt.getName());
+  lox::Resolver::declare(_stmt.getName(), _stmt.getId());
 
   if (_stmt.getInitializer() != nullptr) {
     lox::Resolver::resolve(_stmt.getInitializer());
@@ -173,7 +185,7 @@ void lox::Resolver::visitWhileStmt(const lox::stmt::While& _stmt) {
 
 void lox::Resolver::visitAssignExpr(const lox::expr::Assign& _expr) {
   lox::Resolver::resolve(_expr.getValue());
-  lox::Resolver::resolveLocal(_expr, _expr.getName());
+  lox::Resolver::resolveLocal(_expr.getId(), _expr.getName().getLexeme());
   return;
 }
 
@@ -192,7 +204,14 @@ void lox::Resolver::visitBinaryExpr(const lox::expr::Binary& _expr) {
 void lox::Resolver::visitCallExpr(const lox::expr::Call& _expr) {
   lox::Resolver::resolve(_expr.getCallee());
 
-  for (lox::expr::Expr argument : _expr.getArguments()) {
+  // a method call runs as one invoke, without binding the method first
+  if (const lox::expr::Get* get = gets[_expr.getCallee().getId()]) {
+    getInterpreter().resolveInvoke(_expr.getId(), *get);
+  }
+
+  calls.set(_expr.getId(), &_expr);
+
+  for (const lox::expr::Expr& argument : _expr.getArguments()) {
     lox::Resolver::resolve(argument);
   }
 
@@ -204,6 +223,7 @@ void lox::Resolver::visitCallExpr(const lox::expr::Call& _expr) {
 
 void lox::Resolver::visitGetExpr(const lox::expr::Get& _expr) {
   lox::Resolver::resolve(_expr.getObject());
+  gets.set(_expr.getId(), &_expr);
   return;
 }
 
@@ -219,6 +239,15 @@ void lox::Resolver::visitGroupingExpr(const lox::expr::Grouping& _expr) {
 // literal expr
 
 void lox::Resolver::visitLiteralExpr(const lox::expr::Literal& _expr) {
+  if (_expr.getText() == nullptr) {
+    getInterpreter().resolveConstant(_expr.getId(), _expr.getValue());
+    return;
+  }
+
+  // the interpreter's constants keep the string alive from here on
+  Value string =
+      getInterpreter().getHeap().allocate<LoxString>(*_expr.getText());
+  getInterpreter().resolveConstant(_expr.getId(), string);
   return;
 }
 
@@ -254,7 +283,8 @@ void lox::Resolver::visitSuperExpr(const lox::expr::Super& _expr) {
         _expr.getKeyword(), "Can't use 'super' in a class with no superclass.");
   }
 
-  lox::Resolver::resolveLocal(_expr, _expr.getKeyword());
+  lox::Resolver::resolveLocal(_expr.getId(), "super");
+  lox::Resolver::resolveLocal(_expr.getThisId(), "this");
   return;
 }
 
@@ -268,7 +298,7 @@ void lox::Resolver::visitThisExpr(const lox::expr::This& _expr) {
     return;
   }
 
-  lox::Resolver::resolveLocal(_expr, _expr.getKeyword());
+  lox::Resolver::resolveLocal(_expr.getId(), "this");
   return;
 }
 
@@ -284,13 +314,18 @@ void lox::Resolver::visitUnaryExpr(const lox::expr::Unary& _expr) {
 // variable expr
 
 void lox::Resolver::visitVariableExpr(const lox::expr::Variable& _expr) {
-  if (!scopes.empty() && scopes.top()[_expr.getName().getLexeme()] == false) {
-    Lox _lox;
-    _lox.error(
-        _expr.getName(), "Can't read local variable in its own initializer.");
+  if (!scopes.empty()) {
+    auto& locals = scopes.back().locals;
+    auto it = locals.find(_expr.getName().getLexeme());
+
+    if (it != locals.end() && !it->second.defined) {
+      Lox _lox;
+      _lox.error(
+          _expr.getName(), "Can't read local variable in its own initializer.");
+    }
   }
 
-  lox::Resolver::resolveLocal(_expr, _expr.getName());
+  lox::Resolver::resolveLocal(_expr.getId(), _expr.getName().getLexeme());
   return;
 }
 
@@ -315,16 +350,35 @@ void lox::Resolver::resolveFunction(
   FunctionType enclosingFunction = currentFunction;
   currentFunction = type;
 
+  frames.push_back(FrameInfo{function.getId()});
   lox::Resolver::beginScope();
 
-  for (Token param : function.getParams()) {
-    lox::Resolver::declare(param);
-    lox::Resolver::define(param);
+  // the receiver of a method is its first local, keyed on the method's ID
+  if (type == FunctionType::METHOD || type == FunctionType::INITIALIZER) {
+    lox::Resolver::declare("this", function.getId());
+  }
+
+  const std::vector<Token>& params = function.getParams();
+  for (std::size_t i = 0; i < params.size(); i++) {
+    int id = function.getParamId(static_cast<int>(i));
+    lox::Resolver::declare(params[i], id);
+    lox::Resolver::define(params[i]);
   }
 
   lox::Resolver::resolve(function.getBody());
   lox::Resolver::endScope();
 
+  getInterpreter().resolvePrototype(
+      function,
+      type == FunctionType::METHOD || type == FunctionType::INITIALIZER,
+      type == FunctionType::INITIALIZER);
+
+  const FrameInfo& frame = frames.back();
+  getInterpreter().resolveFrame(
+      function.getId(), FrameLayout{frame.size, frame.cells});
+  getInterpreter().resolveCaptures(function.getId(), frame.captures);
+  frames.pop_back();
+
   currentFunction = enclosingFunction;
 }
 
@@ -332,30 +386,70 @@ void lox::Resolver::resolveFunction(
 // to create new block scope
 
 void lox::Resolver::beginScope() {
-  scopes.push(std::unordered_map<std::string, bool>());
+  scopes.push_back(Scope{frames.back().nextSlot});
 }
 
 
 // exiting from stack
+//
+// Every use of the scope's locals inside their own function is known by
+// now. Locals that no nested function refers to get a slot on the
+// interpreter's value stack; captured ones were given a cell the moment a
+// closure first referred to them.
 
 void lox::Resolver::endScope() {
-  scopes.pop();
+  Scope& scope = scopes.back();
+
+  for (const auto& [name, local] : scope.locals) {
+    Binding binding{BindingKind::STACK, local.slot};
+
+    if (local.cell != -1) {
+      binding = Binding{BindingKind::CELL, local.cell};
+    }
+
+    getInterpreter().resolveBinding(local.declaration, binding);
+    for (const int& node : local.uses) {
+      getInterpreter().resolveBinding(node, binding);
+    }
+  }
+
+  frames.back().nextSlot = scope.firstSlot;
+
+  if (frames.size() == 1) {
+    const FrameInfo& frame = frames.back();
+    getInterpreter().resolveFrame(-1, FrameLayout{frame.size, frame.cells});
+  }
+
+  scopes.pop_back();
 }
 
 
-void lox::Resolver::declare(const Token& name) {
+void lox::Resolver::declare(const Token& name, const int& declaration) {
   if (scopes.empty()) {
+    getInterpreter().resolveGlobal(declaration, name.getLexeme());
     return;
   }
 
-  std::unordered_map<std::string, bool> scope = scopes.top();
-
-  if (scope[name.getLexeme()]) {
+  if (scopes.back().locals.count(name.getLexeme()) != 0) {
     Lox _lox;
     _lox.error(name, "Already a variable with this name in this scope.");
   }
 
-  scope[name.getLexeme()] = false;
+  lox::Resolver::declare(name.getLexeme(), declaration);
+}
+
+
+// "this" and "super" are declared without a token and are defined at once
+
+void lox::Resolver::declare(const std::string& name, const int& declaration) {
+  FrameInfo& frame = frames.back();
+
+  Local local{
+      declaration, static_cast<int>(frames.size()) - 1, frame.nextSlot++};
+  local.defined = name == "this" || name == "super";
+
+  scopes.back().locals[name] = local;
+  frame.size = std::max(frame.size, frame.nextSlot);
 }
 
 
@@ -363,21 +457,70 @@ void lox::Resolver::define(const Token& name) {
   if (scopes.empty()) {
     return;
   }
-  scopes.top()[name.getLexeme()] = true;
+
+  auto it = scopes.back().locals.find(name.getLexeme());
+  if (it != scopes.back().locals.end()) {
+    it->second.defined = true;
+  }
 }
 
 
-void lox::Resolver::resolveLocal(
-    const lox::expr::Expr& _expr,
-    const Token& name) {
+void lox::Resolver::resolveLocal(const int& node, const std::string& name) {
+  const int current = frames.size() - 1;
+
   for (int i = scopes.size() - 1; i >= 0; i--) {
-    auto& scope = scopes.top();
-    auto it = scope.find(name.getLexeme());
-    if (it != scope.end()) {
-      getInterpreter().resolve(_expr, scopes.size() - 1 - i);
-      return;
+    auto it = scopes[i].locals.find(name);
+
+    if (it == scopes[i].locals.end()) {
+      continue;
+    }
+
+    Local& local = it->second;
+
+    if (local.function == current) {
+      local.uses.push_back(node);
+    } else {
+      getInterpreter().resolveBinding(
+          node,
+          Binding{BindingKind::UPVALUE, resolveCapture(current, local)});
     }
+    return;
+  }
+
+  getInterpreter().resolveGlobal(node, name);
+}
+
+
+// A local referred to from a nested function escapes its frame: it moves
+// into a cell, and every function between the declaring one and the user
+// captures that cell, so sibling closures end up sharing it.
+
+int lox::Resolver::resolveCapture(const int& frame, Local& local) {
+  if (frame - 1 == local.function) {
+    if (local.cell == -1) {
+      local.cell = frames[local.function].cells++;
+    }
+    return addCapture(frame, true, local.cell);
   }
+
+  return addCapture(frame, false, resolveCapture(frame - 1, local));
+}
+
+
+int lox::Resolver::addCapture(
+    const int& frame,
+    const bool& local,
+    const int& index) {
+  std::vector<Capture>& captures = frames[frame].captures;
+
+  for (std::size_t i = 0; i < captures.size(); i++) {
+    if (captures[i].local == local && captures[i].index == index) {
+      return static_cast<int>(i);
+    }
+  }
+
+  captures.push_back(Capture{local, index});
+  return captures.size() - 1;
 }
 
 }  // namespace lox
@@ -1,13 +1,13 @@
 #ifndef RESOLVER_H
 #define RESOLVER_H
 
-#include <stack>
 #include <string>
 #include <unordered_map>
 #include <vector>
 
 #include "Expr.h"
 #include "Interpreter.h"
+#include "SideTable.h"
 #include "Stmt.h"
 
 
@@ -28,13 +28,51 @@ enum ClassType {
 };
 
 
+// a name declared in a local scope, tracked until its scope ends so that
+// every use can be bound to either a stack slot or a captured cell
+
+struct Local {
+  int declaration;
+  int function;
+  int slot;
+  int cell = -1;
+  bool defined = false;
+  // node IDs of the expressions in the declaring function that refer to it
+  std::vector<int> uses;
+};
+
+
+struct Scope {
+  int node;
+  int firstSlot;
+  std::unordered_map<std::string, Local> locals;
+};
+
+
+// slot, cell and capture bookkeeping for the function (or top-level script)
+// being resolved
+
+struct FrameInfo {
+  int node;
+  int nextSlot = 0;
+  int size = 0;
+  int cells = 0;
+  std::vector<Capture> captures;
+};
+
+
 class Resolver : public lox::expr::Visitor<void>,
                  public lox::stmt::Visitor<void> {
  private:
   const lox::Interpreter& interpreter;
-  std::stack<std::unordered_map<std::string, bool>> scopes;
+  std::vector<Scope> scopes;
+  std::vector<FrameInfo> frames;
   FunctionType currentFunction = FunctionType::NONE;
   ClassType currentClass = ClassType::_NONE;
+  // property gets and calls seen so far, so an enclosing node can tell what
+  // kind of expression it holds
+  SideTable<const lox::expr::Get*> gets;
+  SideTable<const lox::expr::Call*> calls;
 
  public:
   Resolver(const lox::Interpreter& interpreter);
@@ -70,9 +108,12 @@ class Resolver : public lox::expr::Visitor<void>,
       const FunctionType& type);
   void beginScope();
   void endScope();
-  void declare(const Token& name);
+  void declare(const Token& name, const int& declaration);
+  void declare(const std::string& name, const int& declaration);
   void define(const Token& name);
-  void resolveLocal(const lox::expr::Expr& _expr, const Token& name);
+  void resolveLocal(const int& node, const std::string& name);
+  int resolveCapture(const int& frame, Local& local);
+  int addCapture(const int& frame, const bool& local, const int& index);
 
   lox::Interpreter& getInterpreter() {
     return const_cast<lox::Interpreter&>(interpreter);
@@ -21,7 +21,9 @@ namespace lox {
 
 // https://stackoverflow.com/questions/19918369
 
-Scanner::Scanner(const std::string& source) : source(source) {}
+Scanner::Scanner(const std::string& source) : Scanner() {
+  this->source = source;
+}
 
 
 // reserved words
@@ -124,6 +126,9 @@ void Scanner::scanToken() {
       break;
     case '\t':
       break;
+    case '\n':
+      line++;
+      break;
     case '"':
       Scanner::string();
       break;
@@ -133,7 +138,8 @@ void Scanner::scanToken() {
       } else if (Scanner::isAlpha(c)) {
         Scanner::identifier();
       } else {
-        // Lox::error(line, "Unexpected character");
+        Lox _lox;
+        _lox.error(line, "Unexpected character.");
       }
       break;
   }
@@ -147,11 +153,12 @@ void Scanner::identifier() {
     Scanner::advance();
   }
 
-  std::string text = this->source.substr(start, current);
-  TokenType type = keywords[text];
+  std::string text = this->source.substr(start, current - start);
+  auto keyword = keywords.find(text);
 
-  if (type == NULL) {
-    type = TokenType::IDENTIFIER;
+  TokenType type = TokenType::IDENTIFIER;
+  if (keyword != keywords.end()) {
+    type = keyword->second;
   }
   Scanner::addToken(type);
 }
@@ -172,7 +179,7 @@ void Scanner::number() {
   }
 
   Scanner::addToken(
-      TokenType::NUMBER, std::stod(source.substr(start, current)));  // todo
+      TokenType::NUMBER, std::stod(source.substr(start, current - start)));
 }
 
 
@@ -187,12 +194,14 @@ void Scanner::string() {
   }
 
   if (Scanner::isAtEnd()) {
-    // Lox::error(line, "Unterminated string");
+    Lox _lox;
+    _lox.error(line, "Unterminated string.");
     return;
   }
 
   Scanner::advance();
-  std::string value = source.substr(start + 1, current - 1);
+  // the value leaves out the quotes
+  std::string value = source.substr(start + 1, current - start - 2);
   Scanner::addToken(STRING, value);
 }
 
@@ -267,7 +276,7 @@ void Scanner::addToken(const TokenType& type) {
 
 
 void Scanner::addToken(const TokenType& type, const Object& literal) {
-  std::string text = source.substr(start, current);
+  std::string text = source.substr(start, current - start);
   tokens.push_back(Token(type, text, literal, line));
 }
 
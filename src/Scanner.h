@@ -1,6 +1,8 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 
+#include <cstddef>
+#include <string>
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -15,11 +17,6 @@ using Object = std::variant<std::nullptr_t, std::string, double, bool>;
 
 namespace lox {
 
-inline std::vector<Token> tokens;
-inline int start = 0;
-inline int current = 0;
-inline int line = 1;
-
 // https://stackoverflow.com/questions/42056160
 
 
@@ -27,6 +24,11 @@ class Scanner {
  private:
   std::unordered_map<std::string, TokenType> keywords;
   std::string source;
+  // each scanner starts over, so REPL lines don't pile onto each other
+  std::vector<Token> tokens;
+  std::size_t start = 0;
+  std::size_t current = 0;
+  int line = 1;
 
  public:
   Scanner();
@@ -0,0 +1,30 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <memory>
+#include <vector>
+
+#include "Expr.h"
+#include "Stmt.h"
+#include "Token.h"
+
+
+namespace lox {
+
+// One parsed script or REPL line: its tokens, every node the parser made and
+// the top-level statements. Nodes refer to their tokens, and the resolver's
+// results point at nodes, so the interpreter keeps each script for as long
+// as it lives; see Interpreter::addScript.
+
+struct Script {
+  std::vector<Token> tokens;
+  // every node, in the order the parser made them
+  std::vector<std::unique_ptr<lox::expr::Expr>> exprs;
+  std::vector<std::unique_ptr<lox::stmt::Stmt>> stmts;
+  std::vector<lox::stmt::Stmt> statements;
+};
+
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,71 @@
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Shape.h"
+
+
+namespace lox {
+
+std::uint64_t Shape::nextId = 0;
+
+
+// the slot holding the field, or -1 when instances of this shape lack it
+
+int Shape::lookup(const std::string& name) const {
+  if (names.size() > SCAN_LIMIT) {
+    auto it = index.find(name);
+    return it == index.end() ? -1 : it->second;
+  }
+
+  for (std::size_t slot = 0; slot < names.size(); slot++) {
+    if (names[slot] == name) {
+      return slot;
+    }
+  }
+
+  return -1;
+}
+
+
+// the shape after adding the field; the new field takes the next slot
+
+Shape* Shape::transition(const std::string& name) {
+  auto it = transitions.find(name);
+  if (it != transitions.end()) {
+    return it->second.get();
+  }
+
+  auto child = std::make_unique<Shape>();
+  child->names = names;
+  child->names.push_back(name);
+
+  if (child->names.size() > SCAN_LIMIT) {
+    for (std::size_t slot = 0; slot < child->names.size(); slot++) {
+      child->index[child->names[slot]] = slot;
+    }
+  }
+
+  Shape* shape = child.get();
+  transitions[name] = std::move(child);
+  return shape;
+}
+
+
+int Shape::size() const {
+  return names.size();
+}
+
+
+std::uint64_t Shape::getId() const {
+  return id;
+}
+
+
+const std::string& Shape::getName(const int& slot) const {
+  return names[slot];
+}
+
+}  // namespace lox
@@ -0,0 +1,48 @@
+#ifndef SHAPE_H
+#define SHAPE_H
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+namespace lox {
+
+// The layout shared by every instance that gained the same fields in the same
+// order. A shape maps field names to slot indices; adding a field moves an
+// instance along a transition edge to the child shape, which is created once
+// and then shared. Each class owns the root of its own shape tree.
+
+class Shape {
+ private:
+  // beyond this many fields a lookup goes through a hash index instead of a
+  // linear scan
+  static constexpr std::size_t SCAN_LIMIT = 8;
+  static std::uint64_t nextId;
+
+  // never reused, unlike the address of a shape freed with its class, so
+  // caches can key on it safely
+  const std::uint64_t id;
+  std::vector<std::string> names;
+  std::unordered_map<std::string, int> index;
+  std::unordered_map<std::string, std::unique_ptr<Shape>> transitions;
+
+ public:
+  Shape() : id(nextId++) {}
+  Shape(const Shape&) = delete;
+  Shape& operator=(const Shape&) = delete;
+
+  int lookup(const std::string& name) const;
+  Shape* transition(const std::string& name);
+
+  int size() const;
+  std::uint64_t getId() const;
+  const std::string& getName(const int& slot) const;
+};
+
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef SIDETABLE_H
+#define SIDETABLE_H
+
+#include <cstddef>
+#include <vector>
+
+
+namespace lox {
+
+// Per-node analysis data, indexed by the dense ID the parser assigns to every
+// AST node. Lookups are a single array access; slots that were never written
+// read back as the table's default value.
+
+template <class T>
+class SideTable {
+ private:
+  std::vector<T> values;
+  T fallback;
+
+ public:
+  SideTable() : fallback(T()) {}
+  SideTable(const T& fallback) : fallback(fallback) {}
+
+  typename std::vector<T>::const_reference operator[](const int& id) const {
+    if (id < 0 || static_cast<std::size_t>(id) >= values.size()) {
+      return fallback;
+    }
+    return values[id];
+  }
+
+  typename std::vector<T>::reference at(const int& id) {
+    if (static_cast<std::size_t>(id) >= values.size()) {
+      values.resize(id + 1, fallback);
+    }
+    return values[id];
+  }
+
+  void set(const int& id, const T& value) {
+    at(id) = value;
+  }
+
+  void reserve(const int& count) {
+    if (static_cast<std::size_t>(count) > values.size()) {
+      values.resize(count, fallback);
+    }
+  }
+
+  std::size_t size() const {
+    return values.size();
+  }
+
+  typename std::vector<T>::const_iterator begin() const {
+    return values.begin();
+  }
+
+  typename std::vector<T>::const_iterator end() const {
+    return values.end();
+  }
+};
+
+
+}  // namespace lox
+
+#endif
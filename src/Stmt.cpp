@@ -9,13 +9,7 @@ namespace lox {
 // block
 
 lox::stmt::Block::Block(const std::vector<lox::stmt::Stmt>& statements)
-    : statements(statements) {}
-
-
-template <class T>
-const T lox::stmt::Block::accept(const Visitor<T>& visitor) const {
-  return visitor.visitBlockStmt(*this);
-}
+    : Stmt(Kind::BLOCK), statements(statements) {}
 
 
 const std::vector<lox::stmt::Stmt>& lox::stmt::Block::getStatements() const {
@@ -26,13 +20,7 @@ const std::vector<lox::stmt::Stmt>& lox::stmt::Block::getStatements() const {
 // expression
 
 lox::stmt::Expression::Expression(const lox::expr::Expr& expression)
-    : expression(expression) {}
-
-
-template <class T>
-const T lox::stmt::Expression::accept(const Visitor<T>& visitor) const {
-  return visitor.visitExpressionStmt(*this);
-}
+    : Stmt(Kind::EXPRESSION), expression(expression) {}
 
 
 const lox::expr::Expr& lox::stmt::Expression::getExpression() const {
@@ -46,13 +34,7 @@ lox::stmt::Function::Function(
     const Token& name,
     const std::vector<Token>& params,
     const std::vector<lox::stmt::Stmt>& body)
-    : name(name), params(params), body(body) {}
-
-
-template <class T>
-const T lox::stmt::Function::accept(const Visitor<T>& visitor) const {
-  return visitor.visitFunctionStmt(*this);
-}
+    : Stmt(Kind::FUNCTION), name(name), params(params), body(body) {}
 
 
 const Token& lox::stmt::Function::getName() const {
@@ -76,13 +58,10 @@ lox::stmt::Class::Class(
     const Token& name,
     const lox::expr::Variable& superclass,
     const std::vector<lox::stmt::Function>& methods)
-    : name(name), superclass(superclass), methods(methods) {}
-
-
-template <class T>
-const T lox::stmt::Class::accept(const Visitor<T>& visitor) const {
-  return visitor.visitClassStmt(*this);
-}
+    : Stmt(Kind::CLASS),
+      name(name),
+      superclass(superclass),
+      methods(methods) {}
 
 
 const Token& lox::stmt::Class::getName() const {
@@ -104,15 +83,12 @@ const std::vector<lox::stmt::Function>& lox::stmt::Class::getMethods() const {
 
 lox::stmt::If::If(
     const lox::expr::Expr& condition,
-    const lox::stmt::Stmt* thenBranch,
-    const lox::stmt::Stmt* elseBranch)
-    : condition(condition), thenBranch(thenBranch), elseBranch(elseBranch) {}
-
-
-template <class T>
-const T lox::stmt::If::accept(const Visitor<T>& visitor) const {
-  return visitor.visitIfStmt(*this);
-}
+    const lox::stmt::Stmt& thenBranch,
+    const lox::stmt::Stmt& elseBranch)
+    : Stmt(Kind::IF),
+      condition(condition),
+      thenBranch(thenBranch),
+      elseBranch(elseBranch) {}
 
 
 const lox::expr::Expr& lox::stmt::If::getCondition() const {
@@ -121,25 +97,19 @@ const lox::expr::Expr& lox::stmt::If::getCondition() const {
 
 
 const lox::stmt::Stmt& lox::stmt::If::getThenBranch() const {
-  return *thenBranch;
+  return thenBranch;
 }
 
 
 const lox::stmt::Stmt& lox::stmt::If::getElseBranch() const {
-  return *elseBranch;
+  return elseBranch;
 }
 
 
 // print
 
 lox::stmt::Print::Print(const lox::expr::Expr& expression)
-    : expression(expression) {}
-
-
-template <class T>
-const T lox::stmt::Print::accept(const Visitor<T>& visitor) const {
-  return visitor.visitPrintStmt(*this);
-}
+    : Stmt(Kind::PRINT), expression(expression) {}
 
 
 const lox::expr::Expr& lox::stmt::Print::getExpression() const {
@@ -150,13 +120,7 @@ const lox::expr::Expr& lox::stmt::Print::getExpression() const {
 // return
 
 lox::stmt::Return::Return(const Token& keyword, const lox::expr::Expr& value)
-    : keyword(keyword), value(value) {}
-
-
-template <class T>
-const T lox::stmt::Return::accept(const Visitor<T>& visitor) const {
-  return visitor.visitReturnStmt(*this);
-}
+    : Stmt(Kind::RETURN), keyword(keyword), value(value) {}
 
 
 const Token& lox::stmt::Return::getKeyword() const {
@@ -172,13 +136,7 @@ const lox::expr::Expr& lox::stmt::Return::getValue() const {
 // var
 
 lox::stmt::Var::Var(const Token& name, const lox::expr::Expr& initializer)
-    : name(name), initializer(initializer) {}
-
-
-template <class T>
-const T lox::stmt::Var::accept(const Visitor<T>& visitor) const {
-  return visitor.visitVarStmt(*this);
-}
+    : Stmt(Kind::VAR), name(name), initializer(initializer) {}
 
 
 const Token& lox::stmt::Var::getName() const {
@@ -196,13 +154,7 @@ const lox::expr::Expr& lox::stmt::Var::getInitializer() const {
 lox::stmt::While::While(
     const lox::expr::Expr& condition,
     const lox::stmt::Stmt& body)
-    : condition(condition), body(body) {}
-
-
-template <class T>
-const T lox::stmt::While::accept(const Visitor<T>& visitor) const {
-  return visitor.visitWhileStmt(*this);
-}
+    : Stmt(Kind::WHILE), condition(condition), body(body) {}
 
 
 const lox::expr::Expr& lox::stmt::While::getCondition() const {
@@ -215,13 +167,4 @@ const lox::stmt::Stmt& lox::stmt::While::getBody() const {
 }
 
 
-// accept
-
-/*
-template <class T>
-T accept(const Visitor<T>& visitor) {
-    return visitor(*this);
-}
-*/
-
 }  // namespace lox
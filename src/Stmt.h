@@ -20,20 +20,52 @@ template <class T>
 class Visitor;
 
 
+// which class a node is, so accept can hand it to the matching visit
+// method without a virtual call per visitor type
+
+enum class Kind {
+  NONE,
+  BLOCK,
+  CLASS,
+  EXPRESSION,
+  FUNCTION,
+  IF,
+  PRINT,
+  RETURN,
+  VAR,
+  WHILE,
+};
+
+
 // stmt class
 
 class Stmt {
+ private:
+  // dense node ID handed out by the parser; -1 marks an absent node
+  int id = -1;
+  Kind kind = Kind::NONE;
+  // the node the script owns; the copies a parent node keeps of its
+  // children refer back to it
+  const Stmt* node = nullptr;
+
+ protected:
+  Stmt(const Kind& kind) : kind(kind) {}
+
  public:
+  Stmt() = default;
+  Stmt(const Stmt&) = default;
+  virtual ~Stmt() = default;
+
   friend bool operator==(const Stmt& _x, const Stmt& _y) {
-    return _x == _y;
+    return _x.id == _y.id;
   }
 
-  bool operator==(const std::nullptr_t& _y) const {
-    return *this == _y;
+  bool operator==(const std::nullptr_t&) const {
+    return id < 0;
   }
 
   friend bool operator!=(const Stmt& _x, const Stmt& _y) {
-    return _x != _y;
+    return !(_x == _y);
   }
 
   bool operator!=(const std::nullptr_t& _y) const {
@@ -41,15 +73,40 @@ class Stmt {
   }
 
   Stmt& operator=(const std::nullptr_t&) {
+    id = -1;
+    kind = Kind::NONE;
+    node = nullptr;
     return *this;
   }
 
-  Stmt& operator=(const Stmt&) {
+  Stmt& operator=(const Stmt& other) {
+    id = other.id;
+    kind = other.kind;
+    node = other.node;
     return *this;
   }
 
+  const int& getId() const {
+    return id;
+  }
+
+  // called on the node the script keeps, once it is in place
+  void setId(const int& _id) {
+    id = _id;
+    node = this;
+  }
+
+  const Kind& getKind() const {
+    return kind;
+  }
+
+  // the node this refers to, as the class it was made as
+  const Stmt& getNode() const {
+    return *node;
+  }
+
   template <class T>
-  T accept(const Visitor<T>& visitor) const;
+  T accept(Visitor<T>& visitor) const;
 };
 
 
@@ -57,14 +114,11 @@ class Stmt {
 
 class Block : public Stmt {
  private:
-  const std::vector<Stmt>& statements;
+  std::vector<Stmt> statements;
 
  public:
   Block(const std::vector<Stmt>& statements);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const std::vector<Stmt>& getStatements() const;
 };
 
@@ -73,14 +127,11 @@ class Block : public Stmt {
 
 class Expression : public Stmt {
  private:
-  const lox::expr::Expr& expression;
+  lox::expr::Expr expression;
 
  public:
   Expression(const lox::expr::Expr& expression);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const lox::expr::Expr& getExpression() const;
 };
 
@@ -90,8 +141,8 @@ class Expression : public Stmt {
 class Function : public Stmt {
  private:
   const Token& name;
-  const std::vector<Token>& params;
-  const std::vector<Stmt>& body;
+  std::vector<Token> params;
+  std::vector<Stmt> body;
 
  public:
   Function(
@@ -99,12 +150,14 @@ class Function : public Stmt {
       const std::vector<Token>& params,
       const std::vector<Stmt>& body);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getName() const;
   const std::vector<Token>& getParams() const;
   const std::vector<Stmt>& getBody() const;
+
+  // parameters use the IDs reserved right after the function's own
+  int getParamId(const int& index) const {
+    return getId() + 1 + index;
+  }
 };
 
 
@@ -113,8 +166,8 @@ class Function : public Stmt {
 class Class : public Stmt {
  private:
   const Token& name;
-  const lox::expr::Variable& superclass;
-  const std::vector<lox::stmt::Function>& methods;
+  lox::expr::Variable superclass;
+  std::vector<lox::stmt::Function> methods;
 
  public:
   Class(
@@ -122,12 +175,14 @@ class Class : public Stmt {
       const lox::expr::Variable& superclass,
       const std::vector<lox::stmt::Function>& methods);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getName() const;
   const lox::expr::Variable& getSuperclass() const;
   const std::vector<lox::stmt::Function>& getMethods() const;
+
+  // the local "super" that methods capture uses the ID after the class's
+  int getSuperId() const {
+    return getId() + 1;
+  }
 };
 
 
@@ -135,17 +190,14 @@ class Class : public Stmt {
 
 class If : public Stmt {
  private:
-  const lox::expr::Expr& condition;
-  const Stmt* thenBranch;
-  const Stmt* elseBranch;
+  lox::expr::Expr condition;
+  Stmt thenBranch;
+  Stmt elseBranch;
 
  public:
   If(const lox::expr::Expr& condition,
-     const Stmt* thenBranch,
-     const Stmt* elseBranch);
-
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
+     const Stmt& thenBranch,
+     const Stmt& elseBranch);
 
   const lox::expr::Expr& getCondition() const;
   const Stmt& getThenBranch() const;
@@ -157,14 +209,11 @@ class If : public Stmt {
 
 class Print : public Stmt {
  private:
-  const lox::expr::Expr& expression;
+  lox::expr::Expr expression;
 
  public:
   Print(const lox::expr::Expr& expression);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const lox::expr::Expr& getExpression() const;
 };
 
@@ -174,14 +223,11 @@ class Print : public Stmt {
 class Return : public Stmt {
  private:
   const Token& keyword;
-  const lox::expr::Expr& value;
+  lox::expr::Expr value;
 
  public:
   Return(const Token& keyword, const lox::expr::Expr& value);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getKeyword() const;
   const lox::expr::Expr& getValue() const;
 };
@@ -192,14 +238,11 @@ class Return : public Stmt {
 class Var : public Stmt {
  private:
   const Token& name;
-  const lox::expr::Expr& initializer;
+  lox::expr::Expr initializer;
 
  public:
   Var(const Token& name, const lox::expr::Expr& initializer);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const Token& getName() const;
   const lox::expr::Expr& getInitializer() const;
 };
@@ -209,15 +252,12 @@ class Var : public Stmt {
 
 class While : public Stmt {
  private:
-  const lox::expr::Expr& condition;
-  const Stmt& body;
+  lox::expr::Expr condition;
+  Stmt body;
 
  public:
   While(const lox::expr::Expr& condition, const Stmt& body);
 
-  template <class T>
-  const T accept(const Visitor<T>& visitor) const;
-
   const lox::expr::Expr& getCondition() const;
   const Stmt& getBody() const;
 };
@@ -228,18 +268,49 @@ class While : public Stmt {
 template <class T>
 class Visitor : public Stmt {
  public:
-  virtual T visitBlockStmt(const Block& stmt) const = 0;
-  virtual T visitClassStmt(const Class& stmt) const = 0;
-  virtual T visitExpressionStmt(const Expression& stmt) const = 0;
-  virtual T visitFunctionStmt(const Function& stmt) const = 0;
-  virtual T visitIfStmt(const If& stmt) const = 0;
-  virtual T visitPrintStmt(const Print& stmt) const = 0;
-  virtual T visitReturnStmt(const Return& stmt) const = 0;
-  virtual T visitVarStmt(const Var& stmt) const = 0;
-  virtual T visitWhileStmt(const While& stmt) const = 0;
+  virtual T visitBlockStmt(const Block& stmt) = 0;
+  virtual T visitClassStmt(const Class& stmt) = 0;
+  virtual T visitExpressionStmt(const Expression& stmt) = 0;
+  virtual T visitFunctionStmt(const Function& stmt) = 0;
+  virtual T visitIfStmt(const If& stmt) = 0;
+  virtual T visitPrintStmt(const Print& stmt) = 0;
+  virtual T visitReturnStmt(const Return& stmt) = 0;
+  virtual T visitVarStmt(const Var& stmt) = 0;
+  virtual T visitWhileStmt(const While& stmt) = 0;
 };
 
 
+// dispatch
+
+template <class T>
+T Stmt::accept(Visitor<T>& visitor) const {
+  switch (kind) {
+    case Kind::BLOCK:
+      return visitor.visitBlockStmt(static_cast<const Block&>(*node));
+    case Kind::CLASS:
+      return visitor.visitClassStmt(static_cast<const Class&>(*node));
+    case Kind::EXPRESSION:
+      return visitor.visitExpressionStmt(static_cast<const Expression&>(*node));
+    case Kind::FUNCTION:
+      return visitor.visitFunctionStmt(static_cast<const Function&>(*node));
+    case Kind::IF:
+      return visitor.visitIfStmt(static_cast<const If&>(*node));
+    case Kind::PRINT:
+      return visitor.visitPrintStmt(static_cast<const Print&>(*node));
+    case Kind::RETURN:
+      return visitor.visitReturnStmt(static_cast<const Return&>(*node));
+    case Kind::VAR:
+      return visitor.visitVarStmt(static_cast<const Var&>(*node));
+    case Kind::WHILE:
+      return visitor.visitWhileStmt(static_cast<const While&>(*node));
+    default:
+      break;
+  }
+
+  return T();
+}
+
+
 }  // namespace stmt
 
 }  // namespace lox
@@ -0,0 +1,57 @@
+#ifndef TYPEFEEDBACK_H
+#define TYPEFEEDBACK_H
+
+#include <cstdint>
+
+#include "LoxObject.h"
+#include "Value.h"
+
+
+namespace lox {
+
+// The operand types an operator node has specialized on. A node starts
+// UNINITIALIZED, specializes on the types it first sees and, the first time
+// that guess fails, rewrites itself to GENERIC for good. A specialized node
+// only checks its guard before doing the work. Only the closure engine
+// specializes; its nodes keep the state in their own closures.
+
+enum class Specialization : std::uint8_t {
+  UNINITIALIZED,
+  NUMBER,
+  STRING,
+  GENERIC,
+};
+
+
+// == has no string form, so only + records STRING
+inline Specialization observe(
+    const Value& left,
+    const Value& right,
+    const bool& strings) {
+  if (left.isNumber() && right.isNumber()) {
+    return Specialization::NUMBER;
+  }
+  if (strings && left.is(ObjectType::OBJ_STRING) &&
+      right.is(ObjectType::OBJ_STRING)) {
+    return Specialization::STRING;
+  }
+  return Specialization::GENERIC;
+}
+
+
+// where a node goes after its guard failed on these operands
+inline Specialization rewrite(
+    const Specialization& current,
+    const Value& left,
+    const Value& right,
+    const bool& strings) {
+  if (current == Specialization::UNINITIALIZED) {
+    return observe(left, right, strings);
+  }
+  return Specialization::GENERIC;
+}
+
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,21 @@
+#include <string>
+
+#include "Upvalue.h"
+#include "Value.h"
+
+
+namespace lox {
+
+Upvalue::Upvalue(const Value& value) : value(value) {}
+
+
+const Value& Upvalue::get() const {
+  return value;
+}
+
+
+void Upvalue::set(const Value& value) {
+  this->value = value;
+}
+
+}  // namespace lox
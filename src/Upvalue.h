@@ -0,0 +1,33 @@
+#ifndef UPVALUE_H
+#define UPVALUE_H
+
+#include <string>
+
+#include "Value.h"
+
+
+namespace lox {
+
+// Heap cell holding a local that some closure captures. The declaring frame
+// and every closure that captures the local share the same cell.
+
+class Upvalue {
+ private:
+  Value value;
+  // queued in the heap's remembered set since the last collection
+  bool remembered = false;
+
+  friend class Heap;
+
+ public:
+  Upvalue(const Value& value);
+
+  const Value& get() const;
+  void set(const Value& value);
+};
+
+
+}  // namespace lox
+
+#endif
+#include "Value.h"
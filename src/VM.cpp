@@ -0,0 +1,615 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Chunk.h"
+#include "Compiler.h"
+#include "Heap.h"
+#include "Interpreter.h"
+#include "Lox.h"
+#include "LoxClass.h"
+#include "LoxFunction.h"
+#include "LoxInstance.h"
+#include "LoxString.h"
+#include "RuntimeError.h"
+#include "Token.h"
+#include "TokenType.h"
+#include "Upvalue.h"
+#include "VM.h"
+#include "Value.h"
+
+
+// Threaded dispatch jumps straight from one handler to the next through a
+// table of label addresses; compilers without the labels-as-values
+// extension fall back to a switch.
+#if defined(__GNUC__) || defined(__clang__)
+#define LOX_COMPUTED_GOTO 1
+#endif
+
+
+namespace lox {
+
+VM::VM(lox::Interpreter& interpreter)
+    : interpreter(interpreter),
+      heap(interpreter.getHeap()),
+      globals(interpreter.getGlobals()),
+      stack(STACK_MAX) {
+  top = stack.data();
+  // frames are addressed by pointer while running
+  frames.reserve(FRAMES_MAX);
+  heap.addRoots(this);
+}
+
+
+VM::~VM() {
+  heap.removeRoots(this);
+}
+
+
+// interpret
+
+void VM::interpret(Program compiled) {
+  program = std::move(compiled);
+  frames.clear();
+  cells.clear();
+  top = stack.data();
+
+  const Prototype& script = *program.prototypes.front();
+  cells.resize(script.layout.cells);
+
+  for (int i = 0; i < script.layout.slots; i++) {
+    *top++ = nullptr;
+  }
+
+  frames.push_back(VmFrame{
+      &script, nullptr, script.chunk.getCode().data(), stack.data(), 0,
+      stack.data()});
+
+  try {
+    VM::run();
+  } catch (const RuntimeError& error) {
+    frames.clear();
+    cells.clear();
+    top = stack.data();
+
+    Lox _lox;
+    _lox.runtimeError(error);
+  }
+}
+
+
+// run
+
+void VM::run() {
+  VmFrame* frame;
+  const std::uint8_t* ip;
+  const Chunk* chunk;
+
+#define LOAD_FRAME()              \
+  do {                            \
+    frame = &frames.back();       \
+    ip = frame->ip;               \
+    chunk = &frame->prototype->chunk; \
+  } while (false)
+
+#define READ_BYTE() (*ip++)
+#define READ_SHORT() (ip += 2, static_cast<std::uint16_t>((ip[-2] << 8) | ip[-1]))
+
+#define THROW(message)        \
+  do {                        \
+    frame->ip = ip;           \
+    throw VM::error(message); \
+  } while (false)
+
+#define NUMBER_OP(op)                                  \
+  do {                                                 \
+    Value b = top[-1];                                 \
+    Value a = top[-2];                                 \
+    if (!a.isNumber() || !b.isNumber()) {              \
+      THROW("Operands must be numbers.");              \
+    }                                                  \
+    top[-2] = Value(a.asNumber() op b.asNumber());     \
+    top--;                                             \
+  } while (false)
+
+#ifdef LOX_COMPUTED_GOTO
+#define LOX_OPCODE_LABEL(name) &&op_##name,
+  static const void* dispatch[] = {LOX_OPCODES(LOX_OPCODE_LABEL)};
+#undef LOX_OPCODE_LABEL
+#define CASE(name) op_##name:
+#define NEXT() goto* dispatch[READ_BYTE()]
+#else
+#define CASE(name) case OP_##name:
+#define NEXT() break
+#endif
+
+  LOAD_FRAME();
+
+#ifdef LOX_COMPUTED_GOTO
+  NEXT();
+#else
+  for (;;) {
+    switch (READ_BYTE()) {
+#endif
+
+  CASE(CONSTANT) {
+    *top++ = chunk->getConstants()[READ_SHORT()];
+    NEXT();
+  }
+
+  CASE(NIL) {
+    *top++ = nullptr;
+    NEXT();
+  }
+
+  CASE(TRUE) {
+    *top++ = true;
+    NEXT();
+  }
+
+  CASE(FALSE) {
+    *top++ = false;
+    NEXT();
+  }
+
+  CASE(POP) {
+    top--;
+    NEXT();
+  }
+
+  CASE(GET_LOCAL) {
+    *top++ = frame->slots[READ_SHORT()];
+    NEXT();
+  }
+
+  CASE(DEFINE_LOCAL) {
+    frame->slots[READ_SHORT()] = *--top;
+    NEXT();
+  }
+
+  CASE(SET_LOCAL) {
+    frame->slots[READ_SHORT()] = top[-1];
+    NEXT();
+  }
+
+  CASE(GET_CELL) {
+    *top++ = cells[frame->cellBase + READ_SHORT()]->get();
+    NEXT();
+  }
+
+  CASE(DEFINE_CELL) {
+    interpreter.getCellPool().define(
+        cells[frame->cellBase + READ_SHORT()], *--top);
+    NEXT();
+  }
+
+  CASE(SET_CELL) {
+    const auto& cell = cells[frame->cellBase + READ_SHORT()];
+    heap.writeBarrier(cell, top[-1]);
+    cell->set(top[-1]);
+    NEXT();
+  }
+
+  CASE(GET_UPVALUE) {
+    *top++ = frame->closure->getUpvalues()[READ_SHORT()]->get();
+    NEXT();
+  }
+
+  CASE(SET_UPVALUE) {
+    const auto& cell = frame->closure->getUpvalues()[READ_SHORT()];
+    heap.writeBarrier(cell, top[-1]);
+    cell->set(top[-1]);
+    NEXT();
+  }
+
+  CASE(GET_GLOBAL) {
+    int slot = READ_SHORT();
+    const Token& name = chunk->getName(READ_SHORT());
+    frame->ip = ip;
+    *top++ = globals.get(slot, name);
+    NEXT();
+  }
+
+  CASE(DEFINE_GLOBAL) {
+    int slot = READ_SHORT();
+    READ_SHORT();
+    globals.define(slot, *--top);
+    NEXT();
+  }
+
+  CASE(SET_GLOBAL) {
+    int slot = READ_SHORT();
+    const Token& name = chunk->getName(READ_SHORT());
+    frame->ip = ip;
+    globals.assign(slot, name, top[-1]);
+    NEXT();
+  }
+
+  CASE(GET_PROPERTY) {
+    const Token& name = chunk->getName(READ_SHORT());
+
+    if (!top[-1].is(ObjectType::OBJ_INSTANCE)) {
+      THROW("Only instances have properties.");
+    }
+
+    // the instance stays on the stack while a bound method is allocated
+    frame->ip = ip;
+    top[-1] = top[-1].as<LoxInstance>()->get(name, heap);
+    NEXT();
+  }
+
+  CASE(SET_PROPERTY) {
+    const Token& name = chunk->getName(READ_SHORT());
+
+    if (!top[-2].is(ObjectType::OBJ_INSTANCE)) {
+      THROW("Only instances have fields.");
+    }
+
+    top[-2].as<LoxInstance>()->set(name, top[-1], heap);
+    top[-2] = top[-1];
+    top--;
+    NEXT();
+  }
+
+  CASE(GET_SUPER) {
+    const Token& name = chunk->getName(READ_SHORT());
+    LoxFunction* method =
+        top[-1].as<LoxClass>()->findMethod(name.getLexeme());
+
+    if (method == nullptr) {
+      THROW("Undefined property '" + name.getLexeme() + "'.");
+    }
+
+    top[-2] = method->bind(top[-2].as<LoxInstance>(), heap);
+    top--;
+    NEXT();
+  }
+
+  CASE(EQUAL) {
+    top[-2] = interpreter.isEqual(top[-2], top[-1]);
+    top--;
+    NEXT();
+  }
+
+  CASE(GREATER) {
+    NUMBER_OP(>);
+    NEXT();
+  }
+
+  CASE(GREATER_EQUAL) {
+    NUMBER_OP(>=);
+    NEXT();
+  }
+
+  CASE(LESS) {
+    NUMBER_OP(<);
+    NEXT();
+  }
+
+  CASE(LESS_EQUAL) {
+    NUMBER_OP(<=);
+    NEXT();
+  }
+
+  CASE(ADD) {
+    Value b = top[-1];
+    Value a = top[-2];
+
+    if (a.isNumber() && b.isNumber()) {
+      top[-2] = a.asNumber() + b.asNumber();
+    } else if (a.is(ObjectType::OBJ_STRING) && b.is(ObjectType::OBJ_STRING)) {
+      // both operands are still on the stack if this collects
+      top[-2] = interpreter.concatenate(a.as<LoxString>(), b.as<LoxString>());
+    } else {
+      THROW("Operands must be two numbers or two strings.");
+    }
+
+    top--;
+    NEXT();
+  }
+
+  CASE(SUBTRACT) {
+    NUMBER_OP(-);
+    NEXT();
+  }
+
+  CASE(MULTIPLY) {
+    NUMBER_OP(*);
+    NEXT();
+  }
+
+  CASE(DIVIDE) {
+    NUMBER_OP(/);
+    NEXT();
+  }
+
+  CASE(NOT) {
+    top[-1] = !interpreter.isTruthy(top[-1]);
+    NEXT();
+  }
+
+  CASE(NEGATE) {
+    if (!top[-1].isNumber()) {
+      THROW("Operand must be a number.");
+    }
+
+    top[-1] = -top[-1].asNumber();
+    NEXT();
+  }
+
+  CASE(PRINT) {
+    interpreter.print(*--top);
+    NEXT();
+  }
+
+  CASE(JUMP) {
+    std::uint16_t offset = READ_SHORT();
+    ip += offset;
+    NEXT();
+  }
+
+  CASE(JUMP_IF_FALSE) {
+    std::uint16_t offset = READ_SHORT();
+    if (!interpreter.isTruthy(top[-1])) {
+      ip += offset;
+    }
+    NEXT();
+  }
+
+  CASE(LOOP) {
+    std::uint16_t offset = READ_SHORT();
+    ip -= offset;
+    NEXT();
+  }
+
+  CASE(CALL) {
+    int argc = READ_BYTE();
+    frame->ip = ip;
+    VM::callValue(top[-1 - argc], argc);
+    LOAD_FRAME();
+    NEXT();
+  }
+
+  CASE(TAIL_CALL) {
+    int argc = READ_BYTE();
+    frame->ip = ip;
+    Value* callee = top - argc - 1;
+
+    // only a call that is sure to push a frame gives up this one first; a
+    // class or a bad call goes the usual way, so errors name this line
+    if (callee->is(ObjectType::OBJ_FUNCTION) &&
+        program.functions[callee->as<LoxFunction>()
+                              ->getPrototype()
+                              ->declaration->getId()]
+                ->arity == argc) {
+      interpreter.getCellPool().release(cells, frame->cellBase);
+      Value* base = frame->base;
+      top = std::copy(callee, top, base);
+      frames.pop_back();
+    }
+
+    VM::callValue(top[-1 - argc], argc);
+    LOAD_FRAME();
+    NEXT();
+  }
+
+  CASE(CLOSURE) {
+    const Prototype& prototype = *program.prototypes[READ_SHORT()];
+    frame->ip = ip;
+    *top++ = heap.allocate<LoxFunction>(
+        interpreter.getPrototype(prototype.declaration->getId()),
+        VM::capture(prototype));
+    NEXT();
+  }
+
+  CASE(CLASS) {
+    const Token& name = chunk->getName(READ_SHORT());
+    int count = READ_SHORT();
+    bool hasSuperclass = READ_BYTE() != 0;
+    LoxClass* superclass = nullptr;
+
+    if (hasSuperclass) {
+      if (!top[-1].is(ObjectType::OBJ_CLASS)) {
+        THROW("Superclass must be a class.");
+      }
+      superclass = top[-1].as<LoxClass>();
+    }
+
+    Value* methods = top - count - (hasSuperclass ? 1 : 0);
+    std::unordered_map<std::string, LoxFunction*> table;
+
+    for (int i = 0; i < count; i++) {
+      LoxFunction* method = methods[i].as<LoxFunction>();
+      table[method->getPrototype()->name] = method;
+    }
+
+    // the methods and superclass stay on the stack until the class exists
+    frame->ip = ip;
+    LoxClass* klass =
+        heap.allocate<LoxClass>(name.getLexeme(), superclass, table);
+
+    top = methods;
+    *top++ = klass;
+    NEXT();
+  }
+
+  CASE(RETURN) {
+    Value result = *--top;
+
+    if (frame->prototype->isInitializer) {
+      result = frame->closure->getReceiver();
+    }
+
+    interpreter.getCellPool().release(cells, frame->cellBase);
+    top = frame->base;
+    frames.pop_back();
+
+    if (frames.empty()) {
+      return;
+    }
+
+    *top++ = result;
+    LOAD_FRAME();
+    NEXT();
+  }
+
+#ifndef LOX_COMPUTED_GOTO
+    }
+  }
+#endif
+
+#undef LOAD_FRAME
+#undef READ_BYTE
+#undef READ_SHORT
+#undef THROW
+#undef NUMBER_OP
+#undef CASE
+#undef NEXT
+}
+
+
+// calls
+//
+// The callee and its arguments are already on the stack. Arguments become
+// the callee's first locals in place; a method's receiver takes the slot the
+// callee occupied.
+
+void VM::callValue(const Value& callee, const int& argc) {
+  if (callee.is(ObjectType::OBJ_FUNCTION)) {
+    VM::callFunction(callee.as<LoxFunction>(), argc);
+    return;
+  }
+
+  if (!callee.is(ObjectType::OBJ_CLASS)) {
+    throw VM::error("Can only call functions and classes.");
+  }
+
+  LoxClass* klass = callee.as<LoxClass>();
+  Value* base = top - argc - 1;
+
+  // the class is still in the callee slot while the instance is allocated
+  LoxInstance* instance = heap.allocate<LoxInstance>(klass);
+  *base = instance;
+
+  LoxFunction* initializer = klass->findMethod("init");
+
+  if (initializer == nullptr) {
+    if (argc != 0) {
+      throw VM::error(
+          "Expected 0 arguments but got " + std::to_string(argc) + ".");
+    }
+
+    top = base + 1;
+    return;
+  }
+
+  // the instance stays reachable through the bound initializer's receiver
+  LoxFunction* method = initializer->bind(instance, heap);
+  *base = method;
+  VM::callFunction(method, argc);
+}
+
+
+void VM::callFunction(LoxFunction* function, const int& argc) {
+  const Prototype* prototype =
+      program.functions[function->getPrototype()->declaration->getId()];
+
+  if (argc != prototype->arity) {
+    throw VM::error(
+        "Expected " + std::to_string(prototype->arity) +
+        " arguments but got " + std::to_string(argc) + ".");
+  }
+
+  if (frames.size() == FRAMES_MAX) {
+    throw VM::error("Stack overflow.");
+  }
+
+  Value* base = top - argc - 1;
+  Value* slots = base + 1;
+
+  if (prototype->isMethod) {
+    slots = base;
+    slots[0] = function->getReceiver();
+  }
+
+  Value* end = std::max(top, slots + prototype->layout.slots);
+
+  // leave room for the operand stack of the new frame
+  if (end + 256 > stack.data() + STACK_MAX) {
+    throw VM::error("Stack overflow.");
+  }
+
+  while (top < end) {
+    *top++ = nullptr;
+  }
+
+  int cellBase = cells.size();
+  cells.resize(cellBase + prototype->layout.cells);
+
+  frames.push_back(VmFrame{
+      prototype, function, prototype->chunk.getCode().data(), slots, cellBase,
+      base});
+}
+
+
+// collect the cells a new closure refers to, as Interpreter::capture does
+
+Upvalues VM::capture(const Prototype& prototype) const {
+  const VmFrame& frame = frames.back();
+  Upvalues upvalues;
+
+  for (const Capture& variable : prototype.captures) {
+    if (variable.local) {
+      upvalues.push_back(cells[frame.cellBase + variable.index]);
+    } else {
+      upvalues.push_back(frame.closure->getUpvalues()[variable.index]);
+    }
+  }
+
+  return upvalues;
+}
+
+
+// errors carry the line of the instruction that failed
+
+RuntimeError VM::error(const std::string& message) const {
+  const VmFrame& frame = frames.back();
+  const Chunk& chunk = frame.prototype->chunk;
+  std::size_t offset = frame.ip - chunk.getCode().data() - 1;
+
+  return RuntimeError(
+      Token(TokenType::IDENTIFIER, "", nullptr, chunk.getLine(offset)),
+      message);
+}
+
+
+// collector roots
+
+void VM::markRoots(Heap& heap) {
+  for (Value* slot = stack.data(); slot < top; slot++) {
+    heap.mark(*slot);
+  }
+
+  for (const VmFrame& frame : frames) {
+    heap.mark(frame.closure);
+  }
+
+  for (const auto& cell : cells) {
+    if (cell != nullptr) {
+      heap.mark(cell->get());
+    }
+  }
+
+  for (const auto& prototype : program.prototypes) {
+    for (const Value& value : prototype->chunk.getConstants()) {
+      heap.mark(value);
+    }
+  }
+}
+
+}  // namespace lox
@@ -0,0 +1,72 @@
+#ifndef VM_H
+#define VM_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Chunk.h"
+#include "Compiler.h"
+#include "GlobalTable.h"
+#include "Heap.h"
+#include "Interpreter.h"
+#include "LoxFunction.h"
+#include "RuntimeError.h"
+#include "Value.h"
+
+
+namespace lox {
+
+// an activation of a compiled function
+
+struct VmFrame {
+  const Prototype* prototype;
+  LoxFunction* closure;
+  const std::uint8_t* ip;
+  // first local slot; the operand stack starts after the frame's locals
+  Value* slots;
+  int cellBase;
+  // where the callee sat, and where the result goes on return
+  Value* base;
+};
+
+
+// Stack-based bytecode engine. It runs programs made by the Compiler and
+// shares the interpreter's heap, globals and literal constants, so values
+// mean the same thing in both engines.
+
+class VM : public RootSource {
+ private:
+  static constexpr std::size_t FRAMES_MAX = 1024;
+  static constexpr std::size_t STACK_MAX = FRAMES_MAX * 256;
+
+  lox::Interpreter& interpreter;
+  Heap& heap;
+  GlobalTable& globals;
+  Program program;
+
+  std::vector<Value> stack;
+  Value* top;
+  std::vector<VmFrame> frames;
+  Upvalues cells;
+
+  void run();
+  void callValue(const Value& callee, const int& argc);
+  void callFunction(LoxFunction* function, const int& argc);
+  Upvalues capture(const Prototype& prototype) const;
+  RuntimeError error(const std::string& message) const;
+
+ public:
+  VM(lox::Interpreter& interpreter);
+  VM(const VM&) = delete;
+  VM& operator=(const VM&) = delete;
+  ~VM();
+
+  void interpret(Program compiled);
+  void markRoots(Heap& heap);
+};
+
+}  // namespace lox
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef VALUE_H
+#define VALUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "LoxObject.h"
+
+
+namespace lox {
+
+// A Lox value in 8 bytes. Numbers are stored as plain doubles; every other
+// value hides in the payload of a quiet NaN: nil, true and false use small
+// tags, and heap objects set the sign bit on top of their pointer.
+
+class Value {
+ private:
+  static constexpr std::uint64_t SIGN_BIT = 0x8000000000000000;
+  static constexpr std::uint64_t QNAN = 0x7ffc000000000000;
+
+  static constexpr std::uint64_t TAG_NIL = 1;
+  static constexpr std::uint64_t TAG_FALSE = 2;
+  static constexpr std::uint64_t TAG_TRUE = 3;
+
+  std::uint64_t bits;
+
+ public:
+  Value() : bits(QNAN | TAG_NIL) {}
+  Value(std::nullptr_t) : bits(QNAN | TAG_NIL) {}
+  Value(const bool& b) : bits(QNAN | (b ? TAG_TRUE : TAG_FALSE)) {}
+
+  Value(const double& number) {
+    std::memcpy(&bits, &number, sizeof(double));
+  }
+
+  Value(const LoxObject* object)
+      : bits(SIGN_BIT | QNAN | reinterpret_cast<std::uintptr_t>(object)) {}
+
+  // a string literal would otherwise silently convert to bool
+  Value(const char*) = delete;
+
+  bool isNil() const {
+    return bits == (QNAN | TAG_NIL);
+  }
+
+  bool isBool() const {
+    return (bits | 1) == (QNAN | TAG_TRUE);
+  }
+
+  bool isNumber() const {
+    return (bits & QNAN) != QNAN;
+  }
+
+  bool isObject() const {
+    return (bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT);
+  }
+
+  bool is(const ObjectType& type) const {
+    return isObject() && asObject()->getType() == type;
+  }
+
+  bool asBool() const {
+    return bits == (QNAN | TAG_TRUE);
+  }
+
+  double asNumber() const {
+    double number;
+    std::memcpy(&number, &bits, sizeof(double));
+    return number;
+  }
+
+  LoxObject* asObject() const {
+    return reinterpret_cast<LoxObject*>(bits & ~(SIGN_BIT | QNAN));
+  }
+
+  template <class T>
+  T* as() const {
+    return static_cast<T*>(asObject());
+  }
+
+  const std::uint64_t& getBits() const {
+    return bits;
+  }
+};
+
+
+static_assert(sizeof(Value) == 8, "Value must stay NaN-boxed");
+
+
+}  // namespace lox
+
+#endif
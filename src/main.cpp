@@ -4,6 +4,8 @@
 #include <fstream>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
 
 #include "Lox.h"
 
@@ -13,12 +15,54 @@
 int main(int argc, char** argv) {
   lox::Lox _lox;
   try {
+    std::vector<std::string> args;
+
+    // engine and collector options come before the script
+    for (int i = 1; i < argc; i++) {
+      std::string arg = argv[i];
+
+      if (arg == "--engine=vm") {
+        _lox.setEngine(lox::Engine::VM);
+      } else if (arg == "--engine=closure") {
+        _lox.setEngine(lox::Engine::CLOSURE);
+      } else if (arg == "--engine=tree") {
+        _lox.setEngine(lox::Engine::TREE);
+      } else if (arg == "--gc-stats") {
+        _lox.enableGcStats();
+      } else if (arg == "--ic-stats") {
+        _lox.enableCacheStats();
+      } else if (arg == "--fusion-stats") {
+        _lox.enableFusionStats();
+      } else if (arg == "--call-stats") {
+        _lox.enableCallStats();
+      } else if (arg == "--flush=line") {
+        _lox.getOutput().setPolicy(lox::FlushPolicy::LINE);
+      } else if (arg == "--flush=size") {
+        _lox.getOutput().setPolicy(lox::FlushPolicy::SIZE);
+      } else if (arg == "--flush=exit") {
+        _lox.getOutput().setPolicy(lox::FlushPolicy::EXIT);
+      } else if (arg.rfind("--gc-growth=", 0) == 0) {
+        _lox.getHeap().setGrowthFactor(std::stod(arg.substr(12)));
+      } else if (arg.rfind("--gc-threshold=", 0) == 0) {
+        _lox.getHeap().setMinimumThreshold(std::stoul(arg.substr(15)));
+      } else if (arg.rfind("--gc-nursery=", 0) == 0) {
+        _lox.getHeap().setNurserySize(std::stoul(arg.substr(13)));
+      } else {
+        args.push_back(arg);
+      }
+    }
+
     // https://stackoverflow.com/questions/18649547
-    if (argc > 2) {
-      std::cout << "Usage: " << argv[0] << " [script]\n";
+    if (args.size() > 1) {
+      std::cout << "Usage: " << argv[0] << " [--engine=tree|closure|vm]"
+                << " [--gc-stats] [--ic-stats] [--fusion-stats]"
+                << " [--call-stats] [--flush=line|size|exit]"
+                << " [--gc-growth=<factor>]"
+                   " [--gc-threshold=<bytes>] [--gc-nursery=<bytes>]"
+                   " [script]\n";
       std::exit(1);
-    } else if (argc == 2) {
-      _lox.runFile(argv[1]);
+    } else if (args.size() == 1) {
+      _lox.runFile(args[0]);
     } else {
       _lox.runPrompt();
     }
@@ -27,6 +71,7 @@ int main(int argc, char** argv) {
     // TODO: check std::nested_exception, std::throw_with_nested,
     // std::invalid_argument
     // https://stackoverflow.com/questions/8480640/how-to-throw-a-c-exception
+    _lox.getOutput().flush();
     std::cerr << "Exception: " << e.what() << std::endl;
     std::exit(1);
   }
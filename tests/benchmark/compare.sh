@@ -0,0 +1,40 @@
+#!/bin/sh
+# Times every benchmark script under each engine.
+#
+#   tests/benchmark/compare.sh path/to/main [runs]
+
+LOX=${1:?usage: compare.sh path/to/main [runs]}
+RUNS=${2:-3}
+DIR=$(dirname "$0")
+
+best() {
+  engine=$1
+  script=$2
+  fastest=
+  i=0
+  while [ "$i" -lt "$RUNS" ]; do
+    start=$(date +%s%N)
+    "$LOX" --engine="$engine" "$script" > /dev/null || return 1
+    elapsed=$(( ($(date +%s%N) - start) / 1000000 ))
+    if [ -z "$fastest" ] || [ "$elapsed" -lt "$fastest" ]; then
+      fastest=$elapsed
+    fi
+    i=$((i + 1))
+  done
+  echo "$fastest"
+}
+
+speedup() {
+  awk "BEGIN { printf \"%.2fx\", $1 / ($2 > 0 ? $2 : 1) }"
+}
+
+printf '%-24s %10s %12s %10s %9s %9s\n' \
+  benchmark "tree (ms)" "closure (ms)" "vm (ms)" closure vm
+for script in "$DIR"/*.lox; do
+  tree=$(best tree "$script") || { echo "$script: tree failed"; continue; }
+  closure=$(best closure "$script") || { echo "$script: closure failed"; continue; }
+  vm=$(best vm "$script") || { echo "$script: vm failed"; continue; }
+  printf '%-24s %10s %12s %10s %9s %9s\n' "$(basename "$script" .lox)" \
+    "$tree" "$closure" "$vm" "$(speedup "$tree" "$closure")" \
+    "$(speedup "$tree" "$vm")"
+done